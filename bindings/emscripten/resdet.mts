@@ -163,7 +163,7 @@ class Analysis {
 
 function methods(): Method[] {
 	const methodArray = [];
-	for(let rdmethod = resdet_methods(); Module.getValue(rdmethod,'*'); rdmethod += 12)
+	for(let rdmethod = resdet_methods(); Module.getValue(rdmethod,'*'); rdmethod += 20)
 		methodArray.push(Method.fromRDMethod(rdmethod));
 	return methodArray;
 }
@@ -25,6 +25,21 @@ class RDMethod(ctypes.Structure):
         ("name", ctypes.c_char_p),
         ("func", ctypes.CFUNCTYPE(None)),
         ("threshold", ctypes.c_float),
+        ("init", ctypes.CFUNCTYPE(None)),
+        ("teardown", ctypes.CFUNCTYPE(None)),
+    ]
+
+RDSTAGE_COUNT = 8
+
+class RDStageStats(ctypes.Structure):
+    _fields_ = [
+        ("ns", ctypes.c_uint64),
+        ("count", ctypes.c_uint64)
+    ]
+
+class RDStats(ctypes.Structure):
+    _fields_ = [
+        ("stages", RDStageStats * RDSTAGE_COUNT)
     ]
 
 class RDParameters(ctypes.Structure):
@@ -36,11 +51,17 @@ class RDAnalysis(ctypes.Structure):
 class RDImage(ctypes.Structure):
     pass
 
+class RDFrames(ctypes.Structure):
+    pass
+
 libresdet.resdet_libversion.restype = ctypes.c_char_p
 
 libresdet.resdet_error_str.restype = ctypes.c_char_p
 libresdet.resdet_error_str.argtypes = [ctypes.c_int]
 
+libresdet.resdet_stage_name.restype = ctypes.c_char_p
+libresdet.resdet_stage_name.argtypes = [ctypes.c_int]
+
 libresdet.resdet_methods.restype = ctypes.POINTER(RDMethod)
 libresdet.resdet_methods.argtypes = []
 
@@ -60,6 +81,21 @@ libresdet.resdet_parameters_set_threshold.argtypes = [ctypes.POINTER(RDParameter
 libresdet.resdet_parameters_set_compression_filter.restype = ctypes.c_int
 libresdet.resdet_parameters_set_compression_filter.argtypes = [ctypes.POINTER(RDParameters), ctypes.c_uint8]
 
+libresdet.resdet_parameters_set_huge_pages.restype = ctypes.c_int
+libresdet.resdet_parameters_set_huge_pages.argtypes = [ctypes.POINTER(RDParameters), ctypes.c_bool]
+
+libresdet.resdet_parameters_set_coarse_fraction.restype = ctypes.c_int
+libresdet.resdet_parameters_set_coarse_fraction.argtypes = [ctypes.POINTER(RDParameters), ctypes.c_float]
+
+libresdet.resdet_parameters_set_line_sampling.restype = ctypes.c_int
+libresdet.resdet_parameters_set_line_sampling.argtypes = [ctypes.POINTER(RDParameters), ctypes.c_size_t, ctypes.c_bool]
+
+libresdet.resdet_parameters_set_axes.restype = ctypes.c_int
+libresdet.resdet_parameters_set_axes.argtypes = [ctypes.POINTER(RDParameters), ctypes.c_bool, ctypes.c_bool]
+
+libresdet.resdet_parameters_set_stats.restype = ctypes.c_int
+libresdet.resdet_parameters_set_stats.argtypes = [ctypes.POINTER(RDParameters), ctypes.c_bool]
+
 libresdet.resdet_open_image.restype = ctypes.POINTER(RDImage)
 libresdet.resdet_open_image.argtypes = [
     ctypes.c_char_p, ctypes.c_char_p,
@@ -76,6 +112,22 @@ libresdet.resdet_open_image_with_reader.argtypes = [
     ctypes.POINTER(ctypes.c_int)
 ]
 
+libresdet.resdet_open_image_mem.restype = ctypes.POINTER(RDImage)
+libresdet.resdet_open_image_mem.argtypes = [
+    ctypes.c_void_p, ctypes.c_size_t, ctypes.c_char_p,
+    ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_size_t),
+    ctypes.POINTER(ctypes.POINTER(ctypes.c_float)),
+    ctypes.POINTER(ctypes.c_int)
+]
+
+libresdet.resdet_open_image_fd.restype = ctypes.POINTER(RDImage)
+libresdet.resdet_open_image_fd.argtypes = [
+    ctypes.c_int, ctypes.c_char_p,
+    ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_size_t),
+    ctypes.POINTER(ctypes.POINTER(ctypes.c_float)),
+    ctypes.POINTER(ctypes.c_int)
+]
+
 libresdet.resdet_list_image_readers.restype = ctypes.POINTER(ctypes.c_char_p)
 libresdet.resdet_list_image_readers.argtypes = []
 
@@ -85,6 +137,12 @@ libresdet.resdet_read_image_frame.argtypes = [ctypes.POINTER(RDImage), ctypes.PO
 libresdet.resdet_seek_frame.restype = ctypes.c_bool
 libresdet.resdet_seek_frame.argtypes = [ctypes.POINTER(RDImage), ctypes.c_uint64, ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_uint64), ctypes.c_void_p, ctypes.POINTER(ctypes.c_int)]
 
+libresdet.resdet_image_set_stats.restype = ctypes.c_int
+libresdet.resdet_image_set_stats.argtypes = [ctypes.POINTER(RDImage), ctypes.c_bool]
+
+libresdet.resdet_image_stats.restype = ctypes.c_int
+libresdet.resdet_image_stats.argtypes = [ctypes.POINTER(RDImage), ctypes.POINTER(RDStats)]
+
 libresdet.resdet_close_image.restype = None
 libresdet.resdet_close_image.argtypes = [ctypes.POINTER(RDImage)]
 
@@ -95,6 +153,19 @@ libresdet.resdet_read_image.argtypes = [
     ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_size_t),
 ]
 
+libresdet.resdet_read_frames.restype = ctypes.POINTER(RDFrames)
+libresdet.resdet_read_frames.argtypes = [
+    ctypes.c_char_p, ctypes.c_char_p,
+    ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_size_t),
+    ctypes.POINTER(ctypes.c_int)
+]
+
+libresdet.resdet_get_frame.restype = ctypes.POINTER(ctypes.c_float)
+libresdet.resdet_get_frame.argtypes = [ctypes.POINTER(RDFrames), ctypes.c_size_t]
+
+libresdet.resdet_free_frames.restype = None
+libresdet.resdet_free_frames.argtypes = [ctypes.POINTER(RDFrames)]
+
 libresdet.resdet_create_analysis.restype = ctypes.POINTER(RDAnalysis)
 libresdet.resdet_create_analysis.argtypes = [ctypes.POINTER(RDMethod), ctypes.c_size_t, ctypes.c_size_t, ctypes.POINTER(RDParameters), ctypes.POINTER(ctypes.c_int)]
 
@@ -108,6 +179,16 @@ libresdet.resdet_analysis_results.argtypes = [
     ctypes.POINTER(ctypes.POINTER(RDResolution)), ctypes.POINTER(ctypes.c_size_t)
 ]
 
+libresdet.resdet_analysis_top_results.restype = ctypes.c_int
+libresdet.resdet_analysis_top_results.argtypes = [
+    ctypes.POINTER(RDAnalysis),
+    ctypes.POINTER(RDResolution), ctypes.POINTER(ctypes.c_size_t),
+    ctypes.POINTER(RDResolution), ctypes.POINTER(ctypes.c_size_t)
+]
+
+libresdet.resdet_analysis_stats.restype = ctypes.c_int
+libresdet.resdet_analysis_stats.argtypes = [ctypes.POINTER(RDAnalysis), ctypes.POINTER(RDStats)]
+
 libresdet.resdet_destroy_analysis.restype = None
 libresdet.resdet_destroy_analysis.argtypes = [ctypes.POINTER(RDAnalysis)]
 
@@ -1,4 +1,4 @@
-from libresdet_api import libresdet, RDMethod, RDResolution, RDParameters
+from libresdet_api import libresdet, RDMethod, RDResolution, RDParameters, RDStats, RDSTAGE_COUNT
 
 import ctypes
 from ctypes.util import find_library
@@ -152,14 +152,31 @@ class Image:
 
     def __init__(self, filename: str | os.PathLike, type: Optional[str] = None, image_reader: Optional[str] = None, buffer: Optional[ImageBuffer] = None) -> None:
         type_arg = type.encode("utf-8") if type else None
+        if image_reader:
+            self._open(lambda *args: libresdet.resdet_open_image_with_reader(str(filename).encode("utf-8"), image_reader.encode("utf-8"), *args), buffer)
+        else:
+            self._open(lambda *args: libresdet.resdet_open_image(str(filename).encode("utf-8"), type_arg, *args), buffer)
+
+    @classmethod
+    def from_bytes(cls, data: bytes, type: str, buffer: Optional[ImageBuffer] = None) -> "Image":
+        image = cls.__new__(cls)
+        # libresdet reads the bytes in place, so they're kept alive with the image
+        image._data = data
+        image._open(lambda *args: libresdet.resdet_open_image_mem(data, len(data), type.encode("utf-8"), *args), buffer)
+        return image
+
+    @classmethod
+    def from_fd(cls, fd: int, type: str, buffer: Optional[ImageBuffer] = None) -> "Image":
+        image = cls.__new__(cls)
+        image._open(lambda *args: libresdet.resdet_open_image_fd(fd, type.encode("utf-8"), *args), buffer)
+        return image
+
+    def _open(self, open_image: Callable, buffer: Optional[ImageBuffer]) -> None:
         width = ctypes.c_size_t()
         height = ctypes.c_size_t()
         err = ctypes.c_int()
         buf = ctypes.byref(buffer.data) if buffer else None
-        if image_reader:
-            self._rdimage = libresdet.resdet_open_image_with_reader(str(filename).encode("utf-8"), image_reader.encode("utf-8"), width, height, buf, err)
-        else:
-            self._rdimage = libresdet.resdet_open_image(str(filename).encode("utf-8"), type_arg, width, height, buf, err)
+        self._rdimage = open_image(width, height, buf, err)
         if not self._rdimage:
             raise _rderror_to_exception(err)
 
@@ -204,6 +221,50 @@ class Image:
     def __del__(self) -> None:
         self.close_image()
 
+class Frames:
+    width: int
+    height: int
+    nframes: int
+
+    def __init__(self, filename: str | os.PathLike, type: Optional[str] = None) -> None:
+        type_arg = type.encode("utf-8") if type else None
+        width = ctypes.c_size_t()
+        height = ctypes.c_size_t()
+        nframes = ctypes.c_size_t()
+        err = ctypes.c_int()
+        self._rdframes = libresdet.resdet_read_frames(str(filename).encode("utf-8"), type_arg, width, height, nframes, err)
+        if not self._rdframes:
+            raise _rderror_to_exception(err)
+
+        self.width = width.value
+        self.height = height.value
+        self.nframes = nframes.value
+
+    def __len__(self) -> int:
+        return self.nframes
+
+    def __getitem__(self, index: int) -> c_float_ptr:
+        if index < 0:
+            index += self.nframes
+        if not 0 <= index < self.nframes:
+            raise IndexError(f"Frame index {index} is out of range for {self.nframes} frames")
+        return libresdet.resdet_get_frame(self._rdframes, index)
+
+    def free_frames(self) -> None:
+        libresdet.resdet_free_frames(self._rdframes)
+        self._rdframes = None
+        self.nframes = 0
+
+    def __enter__(self) -> "Frames":
+        return self
+
+    def __exit__(self, type, value, traceback) -> None:
+        self.free_frames()
+        return None
+
+    def __del__(self) -> None:
+        self.free_frames()
+
 class Analysis:
     def __init__(self, width: int, height: int, method: Optional[Method] = None, parameters: dict = {}) -> None:
         params_arg = _dict_to_rdparameters(parameters)
@@ -251,6 +312,29 @@ class Analysis:
 
         return {"widths": widths, "heights": heights}
 
+    def top_results(self, count: int) -> dict:
+        resw = (RDResolution * count)()
+        resh = (RDResolution * count)()
+        countw = ctypes.c_size_t(count)
+        counth = ctypes.c_size_t(count)
+
+        err = libresdet.resdet_analysis_top_results(self._rdanalysis, resw, countw, resh, counth)
+        if err:
+            raise _rderror_to_exception(err)
+
+        widths = _resolution_list_from_rdresolutions(ctypes.cast(resw, ctypes.POINTER(RDResolution)), countw)
+        heights = _resolution_list_from_rdresolutions(ctypes.cast(resh, ctypes.POINTER(RDResolution)), counth)
+
+        return {"widths": widths, "heights": heights}
+
+    def stats(self) -> dict:
+        stats = RDStats()
+        err = libresdet.resdet_analysis_stats(self._rdanalysis, stats)
+        if err:
+            raise _rderror_to_exception(err)
+
+        return _stats_to_dict(stats)
+
     def destroy_analysis(self) -> None:
         libresdet.resdet_destroy_analysis(self._rdanalysis)
         self._rdanalysis = None
@@ -294,7 +378,7 @@ def _dict_to_rdparameters(parameters: dict) -> RDParametersPtr:
     if not parameters:
         return None
 
-    extra_keys = set(parameters.keys()) - set(["range", "threshold", "compression_filter"])
+    extra_keys = set(parameters.keys()) - set(["range", "threshold", "compression_filter", "huge_pages", "coarse_fraction", "line_step", "random_line_offset", "widths", "heights", "stats"])
     if extra_keys:
         raise Exception(f"Unrecognized parameters {', '.join(extra_keys)}")
 
@@ -305,9 +389,25 @@ def _dict_to_rdparameters(parameters: dict) -> RDParametersPtr:
         libresdet.resdet_parameters_set_threshold(rdparameters, parameters["threshold"])
     if "compression_filter" in parameters:
         libresdet.resdet_parameters_set_compression_filter(rdparameters, parameters["compression_filter"])
+    if "huge_pages" in parameters:
+        libresdet.resdet_parameters_set_huge_pages(rdparameters, parameters["huge_pages"])
+    if "coarse_fraction" in parameters:
+        libresdet.resdet_parameters_set_coarse_fraction(rdparameters, parameters["coarse_fraction"])
+    if "line_step" in parameters or "random_line_offset" in parameters:
+        libresdet.resdet_parameters_set_line_sampling(rdparameters, parameters.get("line_step", 1), parameters.get("random_line_offset", False))
+    if "widths" in parameters or "heights" in parameters:
+        libresdet.resdet_parameters_set_axes(rdparameters, parameters.get("widths", True), parameters.get("heights", True))
+    if "stats" in parameters:
+        libresdet.resdet_parameters_set_stats(rdparameters, parameters["stats"])
 
     return rdparameters
 
+def _stats_to_dict(stats: RDStats) -> dict:
+    return {
+        libresdet.resdet_stage_name(i).decode("utf-8"): {"ns": stats.stages[i].ns, "count": stats.stages[i].count}
+        for i in range(RDSTAGE_COUNT)
+    }
+
 def _resolution_list_from_rdresolutions(rdresolution: RDResolutionPtr, count: ctypes.c_size_t) -> list:
     resolutions = []
     for i in range(count.value):
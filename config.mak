@@ -0,0 +1,20 @@
+CC=/usr/bin/cc
+AR=/usr/bin/ar
+CFLAGS_LIB=-march=native -mtune=native -std=c99 -pedantic -O3 -Wall -Werror -DRESDET_EXPORT 
+CFLAGS_CLI=-march=native -mtune=native -std=gnu99 -O3 -Wall -Werror -DRESDET_EXPORT 
+LDFLAGS=
+PREFIX=/usr/local
+BINPREFIX=/usr/local/bin
+LIBPREFIX=/usr/local/lib
+INCPREFIX=/usr/local/include
+PCPREFIX=/usr/local/lib/pkgconfig
+HAVE_LIBJPEG=2
+CFLAGS_libjpeg=
+HAVE_LIBPNG=1
+CFLAGS_libpng=-I/usr/include/libpng16 
+KISS_SIMD=1
+DEFS= -DVERSION_SUFFIX=\"+1697140\" -DHAVE_LIBJPEG=2 -DHAVE_LIBPNG=1 -DHAVE_PTHREAD -DHAVE_MADV_HUGEPAGE -DHAVE_POSIX_FADVISE -DHAVE_FMEMOPEN -DKISS_SIMD -DUSE_BUILTIN_SIGNBIT
+CLIDEFS= -DVERSION_SUFFIX=\"+1697140\" -DHAVE_PTHREAD
+LDLIBS= -lm -pthread -ljpeg -lpng16 
+TOOLS=resdet stat imgread profile synth
+PYTHON=python3
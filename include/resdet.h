@@ -43,42 +43,105 @@ typedef const struct RDMethod {
 	const char* name;
 	void (*func)(void);
 	float threshold;
+	void (*init)(void);
+	void (*teardown)(void);
 } RDMethod;
 
+typedef struct RDAllocator {
+	void* (*malloc_fn)(void* opaque, size_t size);
+	void (*free_fn)(void* opaque, void* ptr);
+	void* (*calloc_fn)(void* opaque, size_t nmemb, size_t size);
+	void* (*aligned_alloc_fn)(void* opaque, size_t alignment, size_t size);
+	void* opaque;
+} RDAllocator;
+
+enum RDStage {
+	RDSTAGE_DECODE,
+	RDSTAGE_CONVERT,
+	RDSTAGE_COPY,
+	RDSTAGE_ROW_TRANSFORM,
+	RDSTAGE_COLUMN_TRANSFORM,
+	RDSTAGE_DETECT_X,
+	RDSTAGE_DETECT_Y,
+	RDSTAGE_RESULTS,
+	RDSTAGE_COUNT
+};
+
+typedef struct RDStats {
+	struct {
+		uint64_t ns;
+		uint64_t count;
+	} stages[RDSTAGE_COUNT];
+} RDStats;
+
+typedef struct RDFileResult {
+	const char* filename;
+	size_t index;
+	RDError error;
+	size_t width, height;
+	uint64_t nframes;
+	RDResolution* rw,* rh;
+	size_t cw, ch;
+	double seconds;
+	RDStats stats;
+} RDFileResult;
+
+typedef void (*RDFileResultFunc)(void* ctx, const RDFileResult* result);
+
 typedef struct RDParameters RDParameters;
 
 typedef struct RDAnalysis RDAnalysis;
 
 typedef struct RDImage RDImage;
 
+typedef struct RDFrames RDFrames;
+
 RESDET_API const char* resdet_libversion(void);
 
 RESDET_API const char* resdet_error_str(RDError);
 RESDET_API enum RDErrors resdet_get_max_error(void);
 
+RESDET_API const char* resdet_stage_name(enum RDStage);
+
 RESDET_API RDMethod* resdet_methods(void);
 RESDET_API RDMethod* resdet_get_method(const char* name);
 
 RESDET_API size_t resdet_default_range(void);
 
+RESDET_API RDError resdet_set_allocator(const RDAllocator* allocator);
+
 RESDET_API RDParameters* resdet_alloc_default_parameters(void);
 
 RESDET_API RDError resdet_parameters_set_range(RDParameters*, size_t range);
 RESDET_API RDError resdet_parameters_set_threshold(RDParameters*, float threshold);
 RESDET_API RDError resdet_parameters_set_compression_filter(RDParameters*, uint8_t value);
+RESDET_API RDError resdet_parameters_set_huge_pages(RDParameters*, bool enable);
+RESDET_API RDError resdet_parameters_set_coarse_fraction(RDParameters*, float fraction);
+RESDET_API RDError resdet_parameters_set_line_sampling(RDParameters*, size_t step, bool random_offset);
+RESDET_API RDError resdet_parameters_set_axes(RDParameters*, bool widths, bool heights);
+RESDET_API RDError resdet_parameters_set_stats(RDParameters*, bool enable);
 
 
 RESDET_API RDImage* resdet_open_image(const char* filename, const char* type, size_t* width, size_t* height, float** imagebuf, RDError* error);
 RESDET_API RDImage* resdet_open_image_with_reader(const char* filename, const char* image_reader_name, size_t* width, size_t* height, float** imagebuf, RDError* error);
+RESDET_API RDImage* resdet_open_image_mem(const void* data, size_t size, const char* filetype, size_t* width, size_t* height, float** imagebuf, RDError* error);
+RESDET_API RDImage* resdet_open_image_fd(int fd, const char* filetype, size_t* width, size_t* height, float** imagebuf, RDError* error);
 
 RESDET_API bool resdet_read_image_frame(RDImage*, float* image, RDError* error);
 
 RESDET_API bool resdet_seek_frame(RDImage*, uint64_t offset, void(*progress)(void* ctx, uint64_t frameno), void* progress_ctx, RDError* error);
 
+RESDET_API RDError resdet_image_set_stats(RDImage*, bool enable);
+RESDET_API RDError resdet_image_stats(RDImage*, RDStats* stats);
+
 RESDET_API void resdet_close_image(RDImage*);
 
 RESDET_API RDError resdet_read_image(const char* filename, const char* filetype, float** image, size_t* nimages, size_t* width, size_t* height);
 
+RESDET_API RDFrames* resdet_read_frames(const char* filename, const char* filetype, size_t* width, size_t* height, size_t* nframes, RDError* error);
+RESDET_API float* resdet_get_frame(const RDFrames*, size_t index);
+RESDET_API void resdet_free_frames(RDFrames*);
+
 RESDET_API const char* const* resdet_list_image_readers(void);
 
 
@@ -89,7 +152,13 @@ RESDET_API RDError resdet_analyze_image(RDAnalysis*, float* image);
 RESDET_API RDError resdet_analysis_results(RDAnalysis*,
                                            RDResolution** restrict resw, size_t* restrict countw,
                                            RDResolution** restrict resh, size_t* restrict counth);
+RESDET_API RDError resdet_analysis_top_results(RDAnalysis*,
+                                               RDResolution* restrict resw, size_t* restrict countw,
+                                               RDResolution* restrict resh, size_t* restrict counth);
+
+RESDET_API RDError resdet_analysis_stats(RDAnalysis*, RDStats* stats);
 
+RESDET_API void resdet_reset_analysis(RDAnalysis*);
 RESDET_API void resdet_destroy_analysis(RDAnalysis*);
 
 
@@ -102,6 +171,9 @@ RESDET_API RDError resdetect_file(const char* filename, const char* filetype,
                                   RDResolution** restrict resw, size_t* restrict countw,
                                   RDResolution** restrict resh, size_t* restrict counth,
                                   RDMethod* method, const RDParameters* params);
+RESDET_API RDError resdetect_files(const char* const* filenames, size_t nfiles, const char* filetype,
+                                   RDMethod* method, const RDParameters* params, unsigned nthreads,
+                                   RDFileResultFunc callback, void* ctx);
 
 
 #endif
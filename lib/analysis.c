@@ -7,6 +7,8 @@
 
 #include "resdet_internal.h"
 
+#define LINE_SEED 0x9E3779B9
+
 static int sortres(const void* left, const void* right) {
 	float left_confidence = ((const RDResolution*)left)->confidence,
 	      right_confidence = ((const RDResolution*)right)->confidence;
@@ -14,7 +16,7 @@ static int sortres(const void* left, const void* right) {
 	return left_confidence < right_confidence ? 1 : (left_confidence > right_confidence ? -1 : 0);
 }
 
-static RDError setup_dimension(size_t length, size_t range, intermediate** buf, rdint_index bounds[2]) {
+static RDError setup_dimension(size_t length, size_t range, intermediate** buf, rdint_index** candidates, rdint_index bounds[2]) {
 	size_t maxlen = 0;
 	if(range < (length+1)/2)
 		maxlen = length - range*2;
@@ -22,7 +24,9 @@ static RDError setup_dimension(size_t length, size_t range, intermediate** buf,
 	if(!maxlen)
 		return RDEOK;
 
-	if(!(*buf = calloc(maxlen,sizeof(**buf))))
+	if(!((*buf        = resdet_calloc(maxlen,sizeof(**buf))       ) &&
+	     (*candidates = resdet_malloc(maxlen*sizeof(**candidates)))
+	))
 		return RDENOMEM;
 	// bounds of result (range of meaningful outputs)
 	// may be narrowed by methods
@@ -31,10 +35,48 @@ static RDError setup_dimension(size_t length, size_t range, intermediate** buf,
 	return RDEOK;
 }
 
+// Packs transformed coefficients into bfloat16 over the front of the same buffer, for the bfloat16 precision experiment.
+// Each chunk is converted before being copied down, so nothing is overwritten before it's been read.
+static const bfloat16* pack_bf16(coeff* f, size_t len) {
+	bfloat16 chunk[64];
+	for(size_t i = 0; i < len; i += 64) {
+		size_t n = len-i < 64 ? len-i : 64;
+		for(size_t j = 0; j < n; j++)
+			chunk[j] = coeff_to_bf16(f[i+j]);
+		memcpy((unsigned char*)f+i*sizeof(*chunk),chunk,n*sizeof(*chunk));
+	}
+	return (const bfloat16*)f;
+}
+
+static inline RDStats* analysis_stats(RDAnalysis* analysis) {
+	return analysis->params.stats ? &analysis->stats : NULL;
+}
+
+// Runs the plan's passes, one at a time when they're being timed.
+static void transform(RDAnalysis* analysis, resdet_plan* p, unsigned passes) {
+	RDStats* stats = analysis_stats(analysis);
+	if(!stats) {
+		resdet_transform(p);
+		return;
+	}
+
+	uint64_t start;
+	if(passes & RESDET_TRANSFORM_ROWS) {
+		start = resdet_time_ns();
+		resdet_transform_pass(p,RESDET_TRANSFORM_ROWS);
+		resdet_stats_add(stats,RDSTAGE_ROW_TRANSFORM,start);
+	}
+	if(passes & RESDET_TRANSFORM_COLUMNS) {
+		start = resdet_time_ns();
+		resdet_transform_pass(p,RESDET_TRANSFORM_COLUMNS);
+		resdet_stats_add(stats,RDSTAGE_COLUMN_TRANSFORM,start);
+	}
+}
+
 RESDET_API RDAnalysis* resdet_create_analysis(RDMethod* method, size_t width, size_t height, const RDParameters* params, RDError* error) {
 	RDError e;
 
-	RDAnalysis* analysis = malloc(sizeof(*analysis));
+	RDAnalysis* analysis = resdet_malloc(sizeof(*analysis));
 	if(!analysis) {
 		e = RDENOMEM;
 		goto error;
@@ -49,12 +91,22 @@ RESDET_API RDAnalysis* resdet_create_analysis(RDMethod* method, size_t width, si
 	analysis->params = params ? *params : default_params;
 	analysis->nimages = 0;
 	analysis->xresult = analysis->yresult = NULL;
-	analysis->p = NULL;
+	analysis->xcandidates = analysis->ycandidates = NULL;
+	analysis->nxcandidates = analysis->nycandidates = 0;
+	analysis->xstate = analysis->ystate = NULL;
+	analysis->bf16_func = NULL;
+	analysis->line_seed = LINE_SEED;
+	analysis->p = analysis->col_p = NULL;
 	analysis->f = NULL;
+	memset(&analysis->stats,0,sizeof(analysis->stats));
 
 	if(analysis->params.threshold < 0)
 		analysis->params.threshold = method->threshold;
 
+	// methods without a bfloat16 variant just use full precision
+	if(analysis->params.bf16_coeffs)
+		analysis->bf16_func = resdet_bf16_method(method);
+
 	// this method has an effective range of 1, so allow a larger bounds
 	if(!strcmp(method->name,"zerox"))
 		analysis->params.range = 1;
@@ -68,20 +120,59 @@ RESDET_API RDAnalysis* resdet_create_analysis(RDMethod* method, size_t width, si
 		goto error;
 	}
 
-	if(!(analysis->f = resdet_alloc_coeffs(width,height))) {
-		e = RDENOMEM;
-		goto error;
+	analysis->sample_rows = ceil(height*analysis->params.coarse_fraction);
+	analysis->sample_cols = ceil(width*analysis->params.coarse_fraction);
+	if(analysis->sample_rows > height)
+		analysis->sample_rows = height;
+	if(analysis->sample_cols > width)
+		analysis->sample_cols = width;
+	analysis->coarse = analysis->sample_rows < height || analysis->sample_cols < width;
+
+	bool widths = analysis->params.widths, heights = analysis->params.heights;
+	unsigned separate = analysis->params.stats ? RESDET_TRANSFORM_SEPARATE : 0;
+	if(analysis->coarse) {
+		// the row and column samples take turns in the same buffer, each only needing its own 1D pass
+		size_t rowsize = widths ? width*analysis->sample_rows : 0, colsize = heights ? analysis->sample_cols*height : 0;
+		if(colsize > rowsize)
+			analysis->f = resdet_alloc_coeffs(analysis->sample_cols,height,analysis->params.huge_pages);
+		else
+			analysis->f = resdet_alloc_coeffs(width,analysis->sample_rows,analysis->params.huge_pages);
+		if(!analysis->f) {
+			e = RDENOMEM;
+			goto error;
+		}
+
+		if(widths && !(analysis->p = resdet_create_plan(analysis->f,width,analysis->sample_rows,RESDET_TRANSFORM_ROWS,&e)))
+			goto error;
+		if(heights && !(analysis->col_p = resdet_create_plan(analysis->f,analysis->sample_cols,height,RESDET_TRANSFORM_COLUMNS,&e)))
+			goto error;
 	}
+	else {
+		if(!(analysis->f = resdet_alloc_coeffs(width,height,analysis->params.huge_pages))) {
+			e = RDENOMEM;
+			goto error;
+		}
 
-	analysis->p = resdet_create_plan(analysis->f,width,height,&e);
-	if(e)
-		goto error;
+		// a single axis only needs the 1D transforms along it
+		unsigned passes = (widths ? RESDET_TRANSFORM_ROWS : 0) | (heights ? RESDET_TRANSFORM_COLUMNS : 0);
+		if(passes && !(analysis->p = resdet_create_plan(analysis->f,width,height,passes|separate,&e)))
+			goto error;
+	}
 
-	if((e = setup_dimension(width,analysis->params.range,&analysis->xresult,analysis->xbound)) != RDEOK)
+	if(widths && (e = setup_dimension(width,analysis->params.range,&analysis->xresult,&analysis->xcandidates,analysis->xbound)) != RDEOK)
 		goto error;
-	if((e = setup_dimension(height,analysis->params.range,&analysis->yresult,analysis->ybound)) != RDEOK)
+	if(heights && (e = setup_dimension(height,analysis->params.range,&analysis->yresult,&analysis->ycandidates,analysis->ybound)) != RDEOK)
 		goto error;
 
+	if(method->init) {
+		if(analysis->xresult &&
+		  (e = ((RDetectInitFunc)method->init)(width,analysis->sample_rows,analysis->params.range,analysis->xbound,analysis->xbound+1,&analysis->xstate)) != RDEOK)
+			goto error;
+		if(analysis->yresult &&
+		  (e = ((RDetectInitFunc)method->init)(height,analysis->sample_cols,analysis->params.range,analysis->ybound,analysis->ybound+1,&analysis->ystate)) != RDEOK)
+			goto error;
+	}
+
 	if(error)
 		*error = RDEOK;
 
@@ -96,6 +187,134 @@ error:
 	return NULL;
 }
 
+// Picks which of count lines are analyzed: every line_step-th, starting from offset.
+// Returns the number of lines picked.
+static size_t sample_lines(RDAnalysis* analysis, size_t count, size_t* offset) {
+	size_t step = analysis->params.line_step;
+	*offset = 0;
+	if(step > 1 && analysis->params.random_line_offset) {
+		// xorshift32, so that successive frames sample different lines but runs are repeatable
+		uint32_t x = analysis->line_seed;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		analysis->line_seed = x;
+		*offset = x % (step < count ? step : count);
+	}
+	return (count - *offset + step - 1) / step;
+}
+
+// Runs the method over the transformed coefficients of a width x height buffer, for either or both axes.
+static RDError detect_dimensions(RDAnalysis* analysis, size_t width, size_t height, bool x, bool y) {
+	RDError ret = RDEOK;
+	size_t step = analysis->params.line_step, xoffset = 0, yoffset = 0, xlines = 0, ylines = 0;
+	if(x && analysis->xresult)
+		xlines = sample_lines(analysis,height,&xoffset);
+	if(y && analysis->yresult)
+		ylines = sample_lines(analysis,width,&yoffset);
+
+	RDStats* stats = analysis_stats(analysis);
+	uint64_t start = resdet_stats_start(stats);
+
+	if(analysis->bf16_func) {
+		const bfloat16* fc = pack_bf16(analysis->f,width*height);
+		// packing is another copy of the coefficients rather than part of either axis
+		if(stats) {
+			uint64_t end = resdet_time_ns();
+			stats->stages[RDSTAGE_COPY].ns += end - start;
+			start = end;
+		}
+		if(xlines) {
+			if((ret = analysis->bf16_func(fc+xoffset*width,width,xlines,width*step,1,analysis->params.range,analysis->xresult,analysis->xbound,analysis->xbound+1,analysis->xstate)) != RDEOK)
+				return ret;
+			resdet_stats_add(stats,RDSTAGE_DETECT_X,start);
+			start = resdet_stats_start(stats);
+		}
+		if(ylines) {
+			ret = analysis->bf16_func(fc+yoffset,height,ylines,step,width,analysis->params.range,analysis->yresult,analysis->ybound,analysis->ybound+1,analysis->ystate);
+			resdet_stats_add(stats,RDSTAGE_DETECT_Y,start);
+		}
+		return ret;
+	}
+
+	if(xlines) {
+		if((ret = ((RDetectFunc)analysis->method->func)(analysis->f+xoffset*width,width,xlines,width*step,1,analysis->params.range,analysis->xresult,analysis->xbound,analysis->xbound+1,analysis->xstate)) != RDEOK)
+			return ret;
+		resdet_stats_add(stats,RDSTAGE_DETECT_X,start);
+		start = resdet_stats_start(stats);
+	}
+	if(ylines) {
+		ret = ((RDetectFunc)analysis->method->func)(analysis->f+yoffset,height,ylines,step,width,analysis->params.range,analysis->yresult,analysis->ybound,analysis->ybound+1,analysis->ystate);
+		resdet_stats_add(stats,RDSTAGE_DETECT_Y,start);
+	}
+	return ret;
+}
+
+// Resizing is separable, so every row carries the horizontal resize and every column the vertical one.
+// Coarse mode transforms evenly spaced samples of each instead of the whole image.
+static RDError analyze_coarse(RDAnalysis* analysis, float* image) {
+	RDError ret;
+	size_t width = analysis->width, height = analysis->height,
+	       rows = analysis->sample_rows, cols = analysis->sample_cols;
+	RDStats* stats = analysis_stats(analysis);
+	uint64_t start;
+
+	if(analysis->p) {
+		start = resdet_stats_start(stats);
+		for(rdint_index r = 0; r < rows; r++) {
+			const float* src = image + (r*height/rows)*width;
+			for(rdint_index i = 0; i < width; i++) {
+				if(!isfinite(src[i]))
+					return RDEINVAL;
+				analysis->f[r*width+i] = src[i];
+			}
+		}
+		resdet_stats_add(stats,RDSTAGE_COPY,start);
+
+		transform(analysis,analysis->p,RESDET_TRANSFORM_ROWS);
+
+		if((ret = detect_dimensions(analysis,width,rows,true,false)) != RDEOK)
+			return ret;
+	}
+
+	if(analysis->col_p) {
+		start = resdet_stats_start(stats);
+		for(rdint_index i = 0; i < height; i++) {
+			const float* src = image + i*width;
+			for(rdint_index c = 0; c < cols; c++) {
+				float val = src[c*width/cols];
+				if(!isfinite(val))
+					return RDEINVAL;
+				analysis->f[i*cols+c] = val;
+			}
+		}
+		resdet_stats_add(stats,RDSTAGE_COPY,start);
+
+		transform(analysis,analysis->col_p,RESDET_TRANSFORM_COLUMNS);
+
+		if((ret = detect_dimensions(analysis,cols,height,false,true)) != RDEOK)
+			return ret;
+	}
+
+	return RDEOK;
+}
+
+// Collects the result offsets passing the threshold and compression filter, returning how many there are.
+static size_t update_candidates(const RDAnalysis* analysis, size_t length, const rdint_index bounds[2], const intermediate* result, rdint_index* candidates) {
+	size_t n = 0;
+
+	float filter_interval = 0;
+	if(analysis->params.compression_filter)
+		filter_interval = length/(float)(1u << analysis->params.compression_filter);
+
+	for(rdint_index i = 0; i < bounds[1]-bounds[0]; i++)
+		if(result[i]/analysis->nimages >= analysis->params.threshold &&
+		  !(filter_interval && round(round(i*filter_interval/length)*length/filter_interval) != i))
+			candidates[n++] = i;
+
+	return n;
+}
+
 RESDET_API RDError resdet_analyze_image(RDAnalysis* analysis, float* image) {
 	if(!(analysis && image))
 		return RDEPARAM;
@@ -103,58 +322,130 @@ RESDET_API RDError resdet_analyze_image(RDAnalysis* analysis, float* image) {
 	RDError ret = RDEOK;
 	size_t width = analysis->width, height = analysis->height;
 
-	for(rdint_index i = 0; i < width*height; i++) {
-		if(!isfinite(image[i])) {
-			ret = RDEINVAL;
+	RDStats* stats = analysis_stats(analysis);
+	uint64_t start;
+
+	if(analysis->coarse) {
+		if((ret = analyze_coarse(analysis,image)) != RDEOK)
 			goto end;
-		}
-		analysis->f[i] = image[i];
 	}
+	else {
+		start = resdet_stats_start(stats);
+		for(rdint_index i = 0; i < width*height; i++) {
+			if(!isfinite(image[i])) {
+				ret = RDEINVAL;
+				goto end;
+			}
+			analysis->f[i] = image[i];
+		}
+		resdet_stats_add(stats,RDSTAGE_COPY,start);
 
-	resdet_transform(analysis->p);
+		if(analysis->p)
+			transform(analysis,analysis->p,(analysis->params.widths ? RESDET_TRANSFORM_ROWS : 0) | (analysis->params.heights ? RESDET_TRANSFORM_COLUMNS : 0));
 
-	if(analysis->xresult &&
-	  (ret = ((RDetectFunc)analysis->method->func)(analysis->f,width,height,width,1,analysis->params.range,analysis->xresult,analysis->xbound,analysis->xbound+1)) != RDEOK)
-		goto end;
-	if(analysis->yresult &&
-	  (ret = ((RDetectFunc)analysis->method->func)(analysis->f,height,width,1,width,analysis->params.range,analysis->yresult,analysis->ybound,analysis->ybound+1)) != RDEOK)
-		goto end;
+		if((ret = detect_dimensions(analysis,width,height,true,true)) != RDEOK)
+			goto end;
+	}
 
 	analysis->nimages++;
 
+	start = resdet_stats_start(stats);
+	if(analysis->xresult)
+		analysis->nxcandidates = update_candidates(analysis,width,analysis->xbound,analysis->xresult,analysis->xcandidates);
+	if(analysis->yresult)
+		analysis->nycandidates = update_candidates(analysis,height,analysis->ybound,analysis->yresult,analysis->ycandidates);
+	resdet_stats_add(stats,RDSTAGE_RESULTS,start);
+
 end:
 	return ret;
 }
 
-static RDError generate_dimension_results(RDAnalysis* analysis, size_t length, rdint_index bounds[2], intermediate* result, RDResolution** res, size_t* count) {
-	size_t nresults = 1;
-
-	float filter_interval = 0;
-	if(analysis->params.compression_filter)
-		filter_interval = length/(float)(1u << analysis->params.compression_filter);
-
-	if(result)
-		for(rdint_index i = 0; i < bounds[1]-bounds[0]; i++)
-			if(result[i]/analysis->nimages >= analysis->params.threshold &&
-			  !(filter_interval && round(round(i*filter_interval/length)*length/filter_interval) != i))
-				nresults++;
+static RDError generate_dimension_results(RDAnalysis* analysis, size_t length, rdint_index bounds[2], intermediate* result, const rdint_index* candidates, size_t ncandidates, RDResolution** res, size_t* count) {
+	if(!result)
+		ncandidates = 0;
 
-	if(!(*res = malloc(nresults*sizeof(**res))))
+	if(!(*res = malloc((ncandidates+1)*sizeof(**res))))
 		return RDENOMEM;
 
 	(*res)[(*count)++] = (RDResolution){length,-1};
 
-	if(result)
-		for(rdint_index i = 0; i < bounds[1]-bounds[0]; i++)
-			if(result[i]/analysis->nimages >= analysis->params.threshold &&
-			  !(filter_interval && round(round(i*filter_interval/length)*length/filter_interval) != i))
-				(*res)[(*count)++] = (RDResolution){i+bounds[0],result[i]/analysis->nimages};
+	for(size_t i = 0; i < ncandidates; i++)
+		(*res)[(*count)++] = (RDResolution){candidates[i]+bounds[0],result[candidates[i]]/analysis->nimages};
 
 	qsort(*res,*count,sizeof(**res),sortres);
 
 	return RDEOK;
 }
 
+// Heap order for top results: a ranks below b. Equal confidences rank the lower index first.
+static inline bool ranks_below(RDResolution a, RDResolution b) {
+	return a.confidence < b.confidence || (a.confidence == b.confidence && a.index > b.index);
+}
+
+static void sift_down(RDResolution* heap, size_t size, size_t i) {
+	for(size_t child; (child = i*2+1) < size; i = child) {
+		if(child+1 < size && ranks_below(heap[child+1],heap[child]))
+			child++;
+		if(!ranks_below(heap[child],heap[i]))
+			break;
+		RDResolution tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+	}
+}
+
+// Selects the best *count candidates into res with a min-heap, then heapsorts them into descending order.
+static void select_top_results(RDAnalysis* analysis, rdint_index bounds[2], const intermediate* result, const rdint_index* candidates, size_t ncandidates, RDResolution* res, size_t* count) {
+	size_t k = *count, size = 0;
+
+	for(size_t i = 0; i < ncandidates && k; i++) {
+		RDResolution r = {candidates[i]+bounds[0],result[candidates[i]]/analysis->nimages};
+		if(size < k) {
+			// sift up
+			size_t j = size++;
+			for(; j && ranks_below(r,res[(j-1)/2]); j = (j-1)/2)
+				res[j] = res[(j-1)/2];
+			res[j] = r;
+		}
+		else if(ranks_below(res[0],r)) {
+			res[0] = r;
+			sift_down(res,size,0);
+		}
+	}
+
+	*count = size;
+	while(size > 1) {
+		RDResolution tmp = res[0];
+		res[0] = res[--size];
+		res[size] = tmp;
+		sift_down(res,size,0);
+	}
+}
+
+RESDET_API RDError resdet_analysis_top_results(RDAnalysis* analysis, RDResolution* restrict rw, size_t* restrict cw, RDResolution* restrict rh, size_t* restrict ch) {
+	if((rw && !cw) || (rh && !ch) || !analysis) {
+		if(cw) *cw = 0;
+		if(ch) *ch = 0;
+		return RDEPARAM;
+	}
+
+	if(!analysis->nimages) {
+		if(cw) *cw = 0;
+		if(ch) *ch = 0;
+		return RDENOIMG;
+	}
+
+	RDStats* stats = analysis_stats(analysis);
+	uint64_t start = resdet_stats_start(stats);
+	if(rw)
+		select_top_results(analysis,analysis->xbound,analysis->xresult,analysis->xcandidates,analysis->nxcandidates,rw,cw);
+	if(rh)
+		select_top_results(analysis,analysis->ybound,analysis->yresult,analysis->ycandidates,analysis->nycandidates,rh,ch);
+	resdet_stats_add(stats,RDSTAGE_RESULTS,start);
+
+	return RDEOK;
+}
+
 RESDET_API RDError resdet_analysis_results(RDAnalysis* analysis, RDResolution** restrict rw, size_t* restrict cw, RDResolution** restrict  rh, size_t* restrict ch) {
 	RDError error = RDEOK;
 
@@ -171,10 +462,13 @@ RESDET_API RDError resdet_analysis_results(RDAnalysis* analysis, RDResolution**
 	if(!analysis->nimages)
 		return RDENOIMG;
 
-	if(rw && (error = generate_dimension_results(analysis,analysis->width,analysis->xbound,analysis->xresult,rw,cw)))
+	RDStats* stats = analysis_stats(analysis);
+	uint64_t start = resdet_stats_start(stats);
+	if(rw && (error = generate_dimension_results(analysis,analysis->width,analysis->xbound,analysis->xresult,analysis->xcandidates,analysis->nxcandidates,rw,cw)))
 		goto error;
-	if(rh && (error = generate_dimension_results(analysis,analysis->height,analysis->ybound,analysis->yresult,rh,ch)))
+	if(rh && (error = generate_dimension_results(analysis,analysis->height,analysis->ybound,analysis->yresult,analysis->ycandidates,analysis->nycandidates,rh,ch)))
 		goto error;
+	resdet_stats_add(stats,RDSTAGE_RESULTS,start);
 
 	return RDEOK;
 
@@ -193,13 +487,48 @@ error:
 	return error;
 }
 
+// Adds rather than copies, so stats can be totaled over images and analyses.
+RESDET_API RDError resdet_analysis_stats(RDAnalysis* analysis, RDStats* stats) {
+	if(!(analysis && stats))
+		return RDEPARAM;
+
+	for(int i = 0; i < RDSTAGE_COUNT; i++) {
+		stats->stages[i].ns += analysis->stats.stages[i].ns;
+		stats->stages[i].count += analysis->stats.stages[i].count;
+	}
+	return RDEOK;
+}
+
+RESDET_API void resdet_reset_analysis(RDAnalysis* analysis) {
+	if(!analysis)
+		return;
+
+	if(analysis->xresult)
+		memset(analysis->xresult,0,(analysis->xbound[1]-analysis->xbound[0])*sizeof(*analysis->xresult));
+	if(analysis->yresult)
+		memset(analysis->yresult,0,(analysis->ybound[1]-analysis->ybound[0])*sizeof(*analysis->yresult));
+	analysis->nxcandidates = analysis->nycandidates = 0;
+	analysis->nimages = 0;
+	analysis->line_seed = LINE_SEED;
+	memset(&analysis->stats,0,sizeof(analysis->stats));
+}
+
 RESDET_API void resdet_destroy_analysis(RDAnalysis* analysis) {
 	if(!analysis)
 		return;
 
-	free(analysis->xresult);
-	free(analysis->yresult);
+	if(analysis->method->teardown) {
+		if(analysis->xstate)
+			((RDetectTeardownFunc)analysis->method->teardown)(analysis->xstate);
+		if(analysis->ystate)
+			((RDetectTeardownFunc)analysis->method->teardown)(analysis->ystate);
+	}
+	resdet_free(analysis->xresult);
+	resdet_free(analysis->yresult);
+	resdet_free(analysis->xcandidates);
+	resdet_free(analysis->ycandidates);
 	resdet_free_plan(analysis->p);
+	resdet_free_plan(analysis->col_p);
 	resdet_free_coeffs(analysis->f);
-	free(analysis);
+	resdet_free(analysis);
 }
@@ -0,0 +1,205 @@
+/*
+ * Batch detection over many files.
+ * This file is part of libresdet.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "resdet_internal.h"
+
+struct batch {
+	const char* const* filenames;
+	size_t nfiles, next;
+	const char* filetype;
+	RDMethod* method;
+	const RDParameters* params;
+	RDFileResultFunc callback;
+	void* ctx;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t lock;
+	// callbacks are serialized separately, so a slow one doesn't hold up workers taking their next file
+	pthread_mutex_t callback_lock;
+#endif
+};
+
+// Each worker keeps its last analysis, so runs of same sized files reuse its plan and buffers.
+struct batch_worker {
+	struct batch* batch;
+	RDAnalysis* analysis;
+	size_t width, height;
+};
+
+static void batch_lock(struct batch* b) {
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&b->lock);
+#endif
+}
+
+static void batch_unlock(struct batch* b) {
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&b->lock);
+#endif
+}
+
+static void report_result(struct batch* b, const RDFileResult* result) {
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&b->callback_lock);
+#endif
+	b->callback(b->ctx,result);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&b->callback_lock);
+#endif
+}
+
+static bool next_file(struct batch* b, size_t* index) {
+	batch_lock(b);
+	bool ret = b->next < b->nfiles;
+	if(ret)
+		*index = b->next++;
+	batch_unlock(b);
+	return ret;
+}
+
+static void detect_file(struct batch_worker* w, size_t index) {
+	struct batch* b = w->batch;
+	RDFileResult result = { .filename = b->filenames[index], .index = index };
+	uint64_t start = resdet_time_ns();
+	bool stats = b->params && b->params->stats;
+
+	float* image = NULL;
+	RDImage* rdimage = resdet_open_image(result.filename,b->filetype,&result.width,&result.height,&image,&result.error);
+	if(result.error)
+		goto end;
+	if(stats)
+		resdet_image_set_stats(rdimage,true);
+
+	if(b->params && b->params->huge_pages)
+		resdet_advise_huge_pages(image,result.width*result.height*sizeof(*image));
+
+	if(w->analysis && w->width == result.width && w->height == result.height)
+		resdet_reset_analysis(w->analysis);
+	else {
+		resdet_destroy_analysis(w->analysis);
+		if(!(w->analysis = resdet_create_analysis(b->method,result.width,result.height,b->params,&result.error)))
+			goto end;
+		w->width = result.width;
+		w->height = result.height;
+	}
+
+	while(resdet_read_image_frame(rdimage,image,&result.error)) {
+		if((result.error = resdet_analyze_image(w->analysis,image)))
+			break;
+		result.nframes++;
+	}
+
+	if(!result.error)
+		result.error = resdet_analysis_results(w->analysis,&result.rw,&result.cw,&result.rh,&result.ch);
+	if(stats)
+		resdet_analysis_stats(w->analysis,&result.stats);
+
+end:
+	if(stats && rdimage)
+		resdet_image_stats(rdimage,&result.stats);
+	free(image);
+	resdet_close_image(rdimage);
+	result.seconds = (resdet_time_ns() - start) / 1e9;
+
+	report_result(b,&result);
+
+	free(result.rw);
+	free(result.rh);
+}
+
+static void* run_worker(void* arg) {
+	struct batch_worker* w = arg;
+	size_t index;
+	while(next_file(w->batch,&index))
+		detect_file(w,index);
+	return NULL;
+}
+
+#ifdef HAVE_PTHREAD
+static unsigned default_threads(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if(n > 0)
+		return n;
+#endif
+	return 1;
+}
+#endif
+
+RESDET_API RDError resdetect_files(const char* const* filenames, size_t nfiles, const char* filetype,
+                                   RDMethod* method, const RDParameters* params, unsigned nthreads,
+                                   RDFileResultFunc callback, void* ctx) {
+	if(!callback || (nfiles && !filenames))
+		return RDEPARAM;
+
+	if(!nfiles)
+		return RDEOK;
+
+	struct batch b = {
+		.filenames = filenames,
+		.nfiles = nfiles,
+		.filetype = filetype,
+		.method = method,
+		.params = params,
+		.callback = callback,
+		.ctx = ctx
+	};
+
+#ifdef HAVE_PTHREAD
+	if(!nthreads)
+		nthreads = default_threads();
+	if(nthreads > nfiles)
+		nthreads = nfiles;
+#else
+	nthreads = 1;
+#endif
+
+	struct batch_worker* workers = resdet_calloc(nthreads,sizeof(*workers));
+	if(!workers)
+		return RDENOMEM;
+	for(unsigned i = 0; i < nthreads; i++)
+		workers[i].batch = &b;
+
+#ifdef HAVE_PTHREAD
+	if(pthread_mutex_init(&b.lock,NULL)) {
+		resdet_free(workers);
+		return RDEINTERNAL;
+	}
+	if(pthread_mutex_init(&b.callback_lock,NULL)) {
+		pthread_mutex_destroy(&b.lock);
+		resdet_free(workers);
+		return RDEINTERNAL;
+	}
+
+	// the calling thread is worker 0, if some threads can't be started the rest just take on more files
+	pthread_t* threads = NULL;
+	unsigned nstarted = 0;
+	if(nthreads > 1 && (threads = resdet_malloc((nthreads-1)*sizeof(*threads))))
+		for(; nstarted < nthreads-1; nstarted++)
+			if(pthread_create(threads+nstarted,NULL,run_worker,workers+nstarted+1))
+				break;
+#endif
+
+	run_worker(workers);
+
+#ifdef HAVE_PTHREAD
+	for(unsigned i = 0; i < nstarted; i++)
+		pthread_join(threads[i],NULL);
+	resdet_free(threads);
+	pthread_mutex_destroy(&b.callback_lock);
+	pthread_mutex_destroy(&b.lock);
+#endif
+
+	for(unsigned i = 0; i < nthreads; i++)
+		resdet_destroy_analysis(workers[i].analysis);
+	resdet_free(workers);
+
+	return RDEOK;
+}
@@ -0,0 +1,19 @@
+/*
+ * Monotonic clock for instrumentation.
+ * This file is part of libresdet.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+
+#include "resdet_internal.h"
+
+uint64_t resdet_time_ns(void) {
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	if(!clock_gettime(CLOCK_MONOTONIC,&ts))
+		return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+	// processor time is the best standard C has to offer
+	return (uint64_t)((double)clock() / CLOCKS_PER_SEC * 1e9);
+}
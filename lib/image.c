@@ -3,6 +3,7 @@
  * This file is part of libresdet.
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include "image.h"
 
 #include <ctype.h>
@@ -10,6 +11,11 @@
 #ifdef _WIN32
 #include <fcntl.h>
 #include <io.h>
+#else
+#include <unistd.h>
+#endif
+#ifdef HAVE_POSIX_FADVISE
+#include <fcntl.h>
 #endif
 
 // advance the file pointer by reading if buf is provided, seeking otherwise
@@ -23,6 +29,18 @@ RDError resdet_fskip(FILE* f, uint64_t offset, void* buf) {
 	return RDEOK;
 }
 
+// Hint that the next length bytes of f will be read soon so the OS can fetch them in the background,
+// e.g. the next frame while the current one is analyzed. Streams without a file position like pipes are left alone.
+void resdet_freadahead(FILE* f, uint64_t length) {
+#ifdef HAVE_POSIX_FADVISE
+	int fd = fileno(f);
+	long pos;
+	if(fd < 0 || !length || (pos = ftell(f)) < 0)
+		return;
+	posix_fadvise(fd,pos,length < LONG_MAX ? (off_t)length : LONG_MAX,POSIX_FADV_WILLNEED);
+#endif
+}
+
 bool resdet_strieq(const char* left, const char* right) {
 	while(*left && *right)
 		if(tolower(*left++) != tolower(*right++))
@@ -44,24 +62,44 @@ static const char* ext_from_mimetype(const char* mimetype) {
 	return "";
 }
 
-static RDImage* open_image(const struct image_reader* image_reader, const char* filename, size_t* width, size_t* height, float** imagebuf, RDError* error) {
-	RDImage* rdimage = malloc(sizeof(*rdimage));
+// Takes ownership of f, which is used in place of filename when set.
+static RDImage* open_image(const struct image_reader* image_reader, const char* filename, FILE* f, size_t* width, size_t* height, float** imagebuf, RDError* error) {
+	RDImage* rdimage = resdet_malloc(sizeof(*rdimage));
 	if(!rdimage) {
+		if(f)
+			fclose(f);
 		*error = RDENOMEM;
 		goto error;
 	}
 
+	rdimage->reader_ctx = NULL;
+	rdimage->f = f;
+	rdimage->stats_enabled = false;
+	memset(&rdimage->stats,0,sizeof(rdimage->stats));
+
 	if(!(rdimage->reader = image_reader)) {
 		*error = RDEUNSUPP;
 		goto error;
 	}
 
 #ifdef _WIN32
-	if(!strcmp(filename,"-"))
+	if(filename && !strcmp(filename,"-"))
 		_setmode(_fileno(stdin), _O_BINARY);
 #endif
 
-	rdimage->reader_ctx = rdimage->reader->open(filename,width,height,error);
+	if(!f && rdimage->reader->open)
+		rdimage->reader_ctx = rdimage->reader->open(filename,width,height,error);
+	else if(!rdimage->reader->open_file) {
+		*error = RDEUNSUPP;
+		goto error;
+	}
+	else {
+		if(!f && !(rdimage->f = strcmp(filename,"-") ? fopen(filename,"rb") : stdin)) {
+			*error = -errno;
+			goto error;
+		}
+		rdimage->reader_ctx = rdimage->reader->open_file(rdimage->f,width,height,error);
+	}
 	if(*error)
 		goto error;
 
@@ -89,6 +127,23 @@ error:
 	return NULL;
 }
 
+// filetype may be an extension or MIME type, and falls back to filename's extension when NULL.
+static const struct image_reader* reader_for_type(const char* filetype, const char* filename) {
+	const char* ext;
+	if(filetype)
+		ext = strchr(filetype,'/') ? ext_from_mimetype(filetype) : filetype;
+	else {
+		ext = strrchr(filename,'.');
+		ext = ext ? ext+1 : "";
+	}
+
+	const struct image_reader** image_readers = resdet_image_readers();
+	for(size_t i = 0; image_readers[i]; i++)
+		if(image_readers[i]->supports_ext(ext))
+			return image_readers[i];
+	return NULL;
+}
+
 RESDET_API RDImage* resdet_open_image(const char* filename, const char* filetype, size_t* width, size_t* height, float** imagebuf, RDError* error) {
 	if(imagebuf)
 		*imagebuf = NULL;
@@ -111,23 +166,7 @@ RESDET_API RDImage* resdet_open_image(const char* filename, const char* filetype
 		goto end;
 	}
 
-	const char* ext;
-	if(filetype)
-		ext = strchr(filetype,'/') ? ext_from_mimetype(filetype) : filetype;
-	else {
-		ext = strrchr(filename,'.');
-		ext = ext ? ext+1 : "";
-	}
-
-	const struct image_reader* reader = NULL;
-	const struct image_reader** image_readers = resdet_image_readers();
-	for(size_t i = 0; image_readers[i]; i++)
-		if(image_readers[i]->supports_ext(ext)) {
-			reader = image_readers[i];
-			break;
-		}
-
-	rdimage = open_image(reader,filename,width,height,imagebuf,&e);
+	rdimage = open_image(reader_for_type(filetype,filename),filename,NULL,width,height,imagebuf,&e);
 
 end:
 	if(error)
@@ -166,7 +205,93 @@ RESDET_API RDImage* resdet_open_image_with_reader(const char* filename, const ch
 			break;
 		}
 
-	rdimage = open_image(reader,filename,width,height,imagebuf,&e);
+	rdimage = open_image(reader,filename,NULL,width,height,imagebuf,&e);
+
+end:
+	if(error)
+		*error = e;
+
+	return rdimage;
+}
+
+RESDET_API RDImage* resdet_open_image_mem(const void* data, size_t size, const char* filetype, size_t* width, size_t* height, float** imagebuf, RDError* error) {
+	if(imagebuf)
+		*imagebuf = NULL;
+
+	RDError e = RDEOK;
+	RDImage* rdimage = NULL;
+
+	if(width)
+		*width = 0;
+	if(height)
+		*height = 0;
+
+	if(!(width && height && data && size && filetype)) {
+		e = RDEPARAM;
+		goto end;
+	}
+
+#ifdef HAVE_FMEMOPEN
+	// the stream reads data in place, so it has to outlive the image
+	FILE* f = fmemopen((void*)data,size,"rb");
+	if(!f) {
+		e = -errno;
+		goto end;
+	}
+
+	rdimage = open_image(reader_for_type(filetype,NULL),NULL,f,width,height,imagebuf,&e);
+#else
+	e = RDEUNSUPP;
+#endif
+
+end:
+	if(error)
+		*error = e;
+
+	return rdimage;
+}
+
+RESDET_API RDImage* resdet_open_image_fd(int fd, const char* filetype, size_t* width, size_t* height, float** imagebuf, RDError* error) {
+	if(imagebuf)
+		*imagebuf = NULL;
+
+	RDError e = RDEOK;
+	RDImage* rdimage = NULL;
+
+	if(width)
+		*width = 0;
+	if(height)
+		*height = 0;
+
+	if(!(width && height && fd >= 0 && filetype)) {
+		e = RDEPARAM;
+		goto end;
+	}
+
+	// read from a duplicate so closing the image leaves the caller's descriptor open
+#ifdef _WIN32
+	int dupfd = _dup(fd);
+	if(dupfd >= 0)
+		_setmode(dupfd,_O_BINARY);
+	FILE* f = dupfd >= 0 ? _fdopen(dupfd,"rb") : NULL;
+	if(!f) {
+		e = -errno;
+		if(dupfd >= 0)
+			_close(dupfd);
+		goto end;
+	}
+#else
+	int dupfd = dup(fd);
+	FILE* f = dupfd >= 0 ? fdopen(dupfd,"rb") : NULL;
+	if(!f) {
+		e = -errno;
+		if(dupfd >= 0)
+			close(dupfd);
+		goto end;
+	}
+#endif
+
+	rdimage = open_image(reader_for_type(filetype,NULL),NULL,f,width,height,imagebuf,&e);
 
 end:
 	if(error)
@@ -183,7 +308,20 @@ RESDET_API bool resdet_read_image_frame(RDImage* rdimage, float* image, RDError*
 	}
 
 	RDError e = RDEOK;
+	RDStats* stats = rdimage->stats_enabled ? &rdimage->stats : NULL;
+	uint64_t start = resdet_stats_start(stats), convert_ns = stats ? stats->stages[RDSTAGE_CONVERT].ns : 0;
+
 	bool ret = rdimage->reader->read_frame(rdimage->reader_ctx,image,rdimage->width,rdimage->height,&e);
+
+	if(stats) {
+		convert_ns = stats->stages[RDSTAGE_CONVERT].ns - convert_ns;
+		stats->stages[RDSTAGE_DECODE].ns += resdet_time_ns() - start - convert_ns;
+		if(ret) {
+			stats->stages[RDSTAGE_DECODE].count++;
+			if(rdimage->reader->set_stats)
+				stats->stages[RDSTAGE_CONVERT].count++;
+		}
+	}
 	if(error)
 		*error = e;
 
@@ -206,13 +344,193 @@ RESDET_API bool resdet_seek_frame(RDImage* rdimage, uint64_t offset, void(*progr
 	return ret;
 }
 
+RESDET_API RDError resdet_image_set_stats(RDImage* rdimage, bool enable) {
+	if(!rdimage)
+		return RDEPARAM;
+
+	rdimage->stats_enabled = enable;
+	if(rdimage->reader->set_stats)
+		rdimage->reader->set_stats(rdimage->reader_ctx,enable ? &rdimage->stats : NULL);
+	return RDEOK;
+}
+
+// Adds rather than copies, like resdet_analysis_stats.
+RESDET_API RDError resdet_image_stats(RDImage* rdimage, RDStats* stats) {
+	if(!(rdimage && stats))
+		return RDEPARAM;
+
+	for(int i = 0; i < RDSTAGE_COUNT; i++) {
+		stats->stages[i].ns += rdimage->stats.stages[i].ns;
+		stats->stages[i].count += rdimage->stats.stages[i].count;
+	}
+	return RDEOK;
+}
+
 RESDET_API void resdet_close_image(RDImage* rdimage) {
 	if(!rdimage)
 		return;
 
 	if(rdimage->reader)
 		rdimage->reader->close(rdimage->reader_ctx);
-	free(rdimage);
+	if(rdimage->f && rdimage->f != stdin)
+		fclose(rdimage->f);
+	resdet_free(rdimage);
+}
+
+// Frames are kept in a list of blocks that never move once filled, so reading a long clip
+// costs no copying and no single huge allocation. Blocks double in size up to FRAME_BLOCK_BYTES.
+#define FRAME_BLOCK_BYTES ((size_t)64*1024*1024)
+
+struct frame_block {
+	struct frame_block* next;
+	size_t nframes;
+	float frames[];
+};
+
+struct RDFrames {
+	size_t width, height, nframes;
+	float** index;
+	size_t index_size;
+	struct frame_block* blocks,* tail;
+	size_t tail_free, block_frames;
+};
+
+static RDError grow_frame_index(RDFrames* frames) {
+	size_t size = frames->index_size ? frames->index_size * 2 : 16;
+	if(size > SIZE_MAX / sizeof(*frames->index))
+		return RDETOOBIG;
+
+	float** index = resdet_malloc(sizeof(*index) * size);
+	if(!index)
+		return RDENOMEM;
+
+	if(frames->nframes)
+		memcpy(index,frames->index,sizeof(*index) * frames->nframes);
+	resdet_free(frames->index);
+	frames->index = index;
+	frames->index_size = size;
+
+	return RDEOK;
+}
+
+static RDError add_frame_block(RDFrames* frames) {
+	size_t frame_size = frames->width * frames->height * sizeof(float);
+	size_t max_frames = FRAME_BLOCK_BYTES / frame_size;
+	if(!max_frames)
+		max_frames = 1;
+
+	size_t nframes = frames->block_frames ? frames->block_frames * 2 : 1;
+	if(nframes > max_frames)
+		nframes = max_frames;
+
+	struct frame_block* block = resdet_malloc(sizeof(*block) + frame_size * nframes);
+	if(!block)
+		return RDENOMEM;
+
+	block->next = NULL;
+	block->nframes = nframes;
+	if(frames->tail)
+		frames->tail->next = block;
+	else
+		frames->blocks = block;
+	frames->tail = block;
+	frames->tail_free = frames->block_frames = nframes;
+
+	return RDEOK;
+}
+
+RESDET_API RDFrames* resdet_read_frames(const char* filename, const char* filetype, size_t* width, size_t* height, size_t* nframes, RDError* error) {
+	RDError e = RDEOK;
+	RDFrames* frames = NULL;
+	RDImage* image = NULL;
+	float* spare = NULL;
+
+	if(nframes)
+		*nframes = 0;
+
+	if(!nframes) {
+		if(width)
+			*width = 0;
+		if(height)
+			*height = 0;
+		e = RDEPARAM;
+		goto error;
+	}
+
+	if(!(image = resdet_open_image(filename,filetype,width,height,NULL,&e)))
+		goto error;
+
+	if(!(frames = resdet_malloc(sizeof(*frames)))) {
+		e = RDENOMEM;
+		goto error;
+	}
+	*frames = (RDFrames){ .width = *width, .height = *height };
+
+	size_t frame_len = *width * *height;
+	// a full tail block is only extended once another frame has actually been read
+	if(!(spare = resdet_malloc(sizeof(*spare) * frame_len))) {
+		e = RDENOMEM;
+		goto error;
+	}
+
+	for(;;) {
+		if(frames->nframes == frames->index_size && (e = grow_frame_index(frames)))
+			goto error;
+
+		float* frame = frames->tail_free ? frames->tail->frames + frame_len * (frames->block_frames - frames->tail_free) : spare;
+		if(!resdet_read_image_frame(image,frame,&e))
+			break;
+
+		if(frame == spare) {
+			if((e = add_frame_block(frames)))
+				goto error;
+			frame = frames->tail->frames;
+			memcpy(frame,spare,sizeof(*spare) * frame_len);
+		}
+
+		frames->tail_free--;
+		frames->index[frames->nframes++] = frame;
+	}
+	if(e)
+		goto error;
+
+	*nframes = frames->nframes;
+
+	goto end;
+
+error:
+	resdet_free_frames(frames);
+	frames = NULL;
+	if(width)
+		*width = 0;
+	if(height)
+		*height = 0;
+
+end:
+	resdet_free(spare);
+	resdet_close_image(image);
+	if(error)
+		*error = e;
+
+	return frames;
+}
+
+RESDET_API float* resdet_get_frame(const RDFrames* frames, size_t index) {
+	if(!frames || index >= frames->nframes)
+		return NULL;
+	return frames->index[index];
+}
+
+RESDET_API void resdet_free_frames(RDFrames* frames) {
+	if(!frames)
+		return;
+
+	for(struct frame_block* block = frames->blocks, * next; block; block = next) {
+		next = block->next;
+		resdet_free(block);
+	}
+	resdet_free(frames->index);
+	resdet_free(frames);
 }
 
 RESDET_API RDError resdet_read_image(const char* filename, const char* filetype, float** images, size_t* nimages, size_t* width, size_t* height) {
@@ -220,33 +538,38 @@ RESDET_API RDError resdet_read_image(const char* filename, const char* filetype,
 	*images = NULL;
 
 	RDError error;
-	RDImage* image = resdet_open_image(filename,filetype,width,height,images,&error);
-	if(error)
+	size_t nframes;
+	RDFrames* frames = resdet_read_frames(filename,filetype,width,height,&nframes,&error);
+	if(!frames)
 		return error;
 
-	while(resdet_read_image_frame(image,*images + *width * *height * *nimages,&error)) {
-		(*nimages)++;
-
-		if(resdet_dims_exceed_limit(*width,*height,*nimages+1,float)) {
-			error = RDETOOBIG;
-			break;
-		}
-
-		float* img = realloc(*images,*width * *height * (*nimages+1) * sizeof(**images));
-		if(!img) {
-			error = RDENOMEM;
-			break;
-		}
+	if(resdet_dims_exceed_limit(*width,*height,nframes ? nframes : 1,float)) {
+		error = RDETOOBIG;
+		goto end;
+	}
 
-		*images = img;
+	size_t frame_len = *width * *height;
+	if(!(*images = malloc(sizeof(**images) * frame_len * (nframes ? nframes : 1)))) {
+		error = RDENOMEM;
+		goto end;
 	}
 
-	if(error) {
-		free(*images);
-		*images = NULL;
+	// pages of the result are only committed as they're written, so releasing each block once
+	// it's copied keeps the footprint near one copy of the image plus a single block
+	size_t copied = 0;
+	struct frame_block* block;
+	while((block = frames->blocks)) {
+		size_t n = block->nframes < nframes - copied ? block->nframes : nframes - copied;
+		memcpy(*images + frame_len * copied,block->frames,sizeof(**images) * frame_len * n);
+		copied += n;
+		frames->blocks = block->next;
+		resdet_free(block);
 	}
+	frames->tail = NULL;
+	*nimages = nframes;
 
-	resdet_close_image(image);
+end:
+	resdet_free_frames(frames);
 
 	return error;
 }
@@ -11,22 +11,36 @@
 #include "resdet_internal.h"
 
 struct image_reader {
+	// A reader provides open, open_file, or both. The FILE passed to open_file is owned by the RDImage and closed after the reader.
 	void* (*open)(const char* filename, size_t* width, size_t* height, RDError*);
+	void* (*open_file)(FILE* f, size_t* width, size_t* height, RDError*);
 	bool (*read_frame)(void* reader_ctx, float* image, size_t width, size_t height, RDError*);
 	bool (*seek_frame)(void* reader_ctx, uint64_t offset, void(*progress)(void*,uint64_t), void* progress_ctx, size_t width, size_t height, RDError*);
 	void (*close)(void*);
 	bool (*supports_ext)(const char*);
+	// optional, for readers that convert decoded pixels in a separate step to time it with resdet_stats_add_convert
+	void (*set_stats)(void* reader_ctx, RDStats*);
 };
 
 struct RDImage {
 	const struct image_reader* reader;
 	void* reader_ctx;
+	FILE* f;
 	size_t width, height;
+	bool stats_enabled;
+	RDStats stats;
 };
 
 bool resdet_strieq(const char* left, const char* right);
 RDError resdet_fskip(FILE* f, uint64_t offset, void* buf);
+void resdet_freadahead(FILE* f, uint64_t length);
 
 const struct image_reader** resdet_image_readers(void);
 
+// Conversion is timed within a frame's decode, which resdet_read_image_frame then excludes from the decode stage.
+static inline void resdet_stats_add_convert(RDStats* stats, uint64_t start) {
+	if(stats)
+		stats->stages[RDSTAGE_CONVERT].ns += resdet_time_ns() - start;
+}
+
 #endif
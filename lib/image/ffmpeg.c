@@ -18,8 +18,12 @@ struct ffmpeg_context {
 	struct SwsContext* sws;
 	AVFrame* swsframe,* frame;
 	AVPacket* packet;
+	AVIOContext* io;
+	RDStats* stats;
 };
 
+#define IO_BUFFER_SIZE 65536
+
 static RDError rderror_from_averror(int averr) {
 	if(!averr)
 		return RDEOK;
@@ -42,13 +46,39 @@ static void ffmpeg_reader_close(void* reader_ctx) {
 	av_packet_free(&ctx->packet);
 	sws_freeContext(ctx->sws);
 	avformat_close_input(&ctx->fmt);
-	free(ctx);
+	if(ctx->io) {
+		av_freep(&ctx->io->buffer);
+		avio_context_free(&ctx->io);
+	}
+	resdet_free(ctx);
 }
 
 #define little_endian() (union { int i; char c; }){1}.c
 
-static void* ffmpeg_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
-	struct ffmpeg_context* ctx = malloc(sizeof(*ctx));
+static int read_file_packet(void* opaque, uint8_t* buf, int size) {
+	FILE* f = opaque;
+	size_t nread = fread(buf,1,size,f);
+	if(!nread)
+		return ferror(f) ? AVERROR(EIO) : AVERROR_EOF;
+	return nread;
+}
+
+static int64_t seek_file(void* opaque, int64_t offset, int whence) {
+	FILE* f = opaque;
+	if(whence == AVSEEK_SIZE) {
+		long pos = ftell(f), size;
+		if(pos < 0 || fseek(f,0,SEEK_END) || (size = ftell(f)) < 0 || fseek(f,pos,SEEK_SET))
+			return AVERROR(errno);
+		return size;
+	}
+	if(fseek(f,offset,whence & ~AVSEEK_FORCE))
+		return AVERROR(errno);
+	return ftell(f);
+}
+
+// reads from f through a custom AVIOContext when it's set, otherwise opens filename
+static void* ffmpeg_open(const char* filename, FILE* f, size_t* width, size_t* height, RDError* error) {
+	struct ffmpeg_context* ctx = resdet_malloc(sizeof(*ctx));
 	if(!ctx) {
 		*error = RDENOMEM;
 		return NULL;
@@ -56,14 +86,30 @@ static void* ffmpeg_reader_open(const char* filename, size_t* width, size_t* hei
 
 	ctx->fmt = NULL;
 	ctx->codec = NULL;
+	ctx->stats = NULL;
 	ctx->sws = NULL;
 	ctx->swsframe = ctx->frame = NULL;
 	ctx->packet = NULL;
+	ctx->io = NULL;
 
-	if(!strcmp(filename,"-"))
+	int averr = 0;
+	if(f) {
+		unsigned char* buf = av_malloc(IO_BUFFER_SIZE);
+		if(!buf || !(ctx->io = avio_alloc_context(buf,IO_BUFFER_SIZE,0,f,read_file_packet,NULL,fseek(f,0,SEEK_CUR) ? NULL : seek_file))) {
+			av_free(buf);
+			*error = RDENOMEM;
+			goto error;
+		}
+		if(!(ctx->fmt = avformat_alloc_context())) {
+			*error = RDENOMEM;
+			goto error;
+		}
+		ctx->fmt->pb = ctx->io;
+		filename = "";
+	}
+	else if(!strcmp(filename,"-"))
 		filename = "pipe:";
 
-	int averr;
 	if((averr = avformat_open_input(&ctx->fmt,filename,NULL,NULL)) ||
 	   (averr = avformat_find_stream_info(ctx->fmt,NULL)) < 0)
 		goto error;
@@ -116,6 +162,14 @@ error:
 	return NULL;
 }
 
+static void* ffmpeg_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
+	return ffmpeg_open(filename,NULL,width,height,error);
+}
+
+static void* ffmpeg_reader_open_file(FILE* f, size_t* width, size_t* height, RDError* error) {
+	return ffmpeg_open(NULL,f,width,height,error);
+}
+
 static int read_frame(struct ffmpeg_context* ctx) {
 	int averr;
 	while((averr = avcodec_receive_frame(ctx->codec, ctx->swsframe)) == AVERROR(EAGAIN)) {
@@ -137,11 +191,16 @@ static bool ffmpeg_reader_read_frame(void* reader_ctx, float* image, size_t widt
 	struct ffmpeg_context* ctx = reader_ctx;
 
 	int averr = read_frame(ctx);
-	if(averr || (averr = sws_scale_frame(ctx->sws,ctx->frame,ctx->swsframe)) < 0)
+	if(averr)
+		goto averror;
+
+	uint64_t start = resdet_stats_start(ctx->stats);
+	if((averr = sws_scale_frame(ctx->sws,ctx->frame,ctx->swsframe)) < 0)
 		goto averror;
 
 	for(size_t y = 0; y < height; y++)
 		memcpy(image+y*width,ctx->frame->data[0]+y*ctx->frame->linesize[0],width*sizeof(float));
+	resdet_stats_add_convert(ctx->stats,start);
 
 	return true;
 
@@ -181,10 +240,16 @@ static bool ffmpeg_reader_supports_ext(const char* ext) {
 #endif
 }
 
+static void ffmpeg_reader_set_stats(void* reader_ctx, RDStats* stats) {
+	((struct ffmpeg_context*)reader_ctx)->stats = stats;
+}
+
 struct image_reader resdet_image_reader_ffmpeg = {
 	.open = ffmpeg_reader_open,
+	.open_file = ffmpeg_reader_open_file,
 	.read_frame = ffmpeg_reader_read_frame,
 	.seek_frame = ffmpeg_reader_seek_frame,
 	.close = ffmpeg_reader_close,
 	.supports_ext = ffmpeg_reader_supports_ext,
+	.set_stats = ffmpeg_reader_set_stats,
 };
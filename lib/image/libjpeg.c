@@ -17,6 +17,8 @@ static void jerr_reset_error_mgr(j_common_ptr cinfo) {}
 struct libjpeg_context {
 	FILE* f;
 	bool eof;
+	unsigned char* rows;
+	RDStats* stats;
 	struct jpeg_decompress_struct cinfo;
 };
 
@@ -26,26 +28,21 @@ static void libjpeg_reader_close(void* reader_ctx) {
 		return;
 
 	jpeg_destroy_decompress(&ctx->cinfo);
-	if(ctx->f != stdin)
-		fclose(ctx->f);
-	free(ctx);
+	resdet_free(ctx->rows);
+	resdet_free(ctx);
 }
 
-static void* libjpeg_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
-	struct libjpeg_context* ctx = malloc(sizeof(*ctx));
+static void* libjpeg_reader_open_file(FILE* f, size_t* width, size_t* height, RDError* error) {
+	struct libjpeg_context* ctx = resdet_malloc(sizeof(*ctx));
 	if(!ctx) {
 		*error = RDENOMEM;
 		return NULL;
 	}
 
 	ctx->eof = false;
-
-	ctx->f = strcmp(filename,"-") ? fopen(filename,"rb") : stdin;
-	if(!ctx->f) {
-		*error = -errno;
-		free(ctx);
-		return NULL;
-	}
+	ctx->rows = NULL;
+	ctx->stats = NULL;
+	ctx->f = f;
 
 	ctx->cinfo.err = &(struct jpeg_error_mgr){
 		.error_exit      = jerr_error_exit,
@@ -62,11 +59,23 @@ static void* libjpeg_reader_open(const char* filename, size_t* width, size_t* he
 	jpeg_stdio_src(&ctx->cinfo,ctx->f);
 	jpeg_read_header(&ctx->cinfo,TRUE);
 	ctx->cinfo.out_color_space = JCS_GRAYSCALE;
+#ifdef LIBJPEG_FAST_DCT
+	// trade IDCT accuracy for speed, output dimensions are unchanged
+	ctx->cinfo.dct_method = JDCT_IFAST;
+	ctx->cinfo.do_fancy_upsampling = FALSE;
+	ctx->cinfo.do_block_smoothing = FALSE;
+#endif
 	jpeg_start_decompress(&ctx->cinfo);
 
 	*width = ctx->cinfo.output_width;
 	*height = ctx->cinfo.output_height;
 
+	// only buffer as many scanlines as libjpeg produces at once, these are converted as they're decoded
+	if(!(ctx->rows = resdet_malloc(*width * ctx->cinfo.rec_outbuf_height))) {
+		*error = RDENOMEM;
+		goto error;
+	}
+
 	return ctx;
 
 error:
@@ -80,30 +89,29 @@ static bool libjpeg_reader_read_frame(void* reader_ctx, float* image, size_t wid
 	if(ctx->eof)
 		return false;
 
-	unsigned char* imagec = malloc(width * height);
-	if(!imagec) {
-		*error = RDENOMEM;
-		goto end;
-	}
+	size_t nrows = ctx->cinfo.rec_outbuf_height;
+	unsigned char* imagec = ctx->rows;
 
 	if(setjmp(ctx->cinfo.client_data = (jmp_buf){0})) {
 		*error = RDEINVAL;
 		goto end;
 	}
 
-	unsigned char* it = imagec;
+	float* it = image;
 	while(ctx->cinfo.output_scanline < ctx->cinfo.output_height) {
-		unsigned char* rows[ctx->cinfo.rec_outbuf_height];
-		for(int i = 0; i < ctx->cinfo.rec_outbuf_height; i++)
-			rows[i] = it+i*ctx->cinfo.output_width;
-		it += jpeg_read_scanlines(&ctx->cinfo,rows,ctx->cinfo.rec_outbuf_height) * ctx->cinfo.output_width;
+		unsigned char* rows[nrows];
+		for(size_t i = 0; i < nrows; i++)
+			rows[i] = imagec+i*width;
+		size_t n = jpeg_read_scanlines(&ctx->cinfo,rows,nrows) * width;
+		uint64_t start = resdet_stats_start(ctx->stats);
+		for(size_t i = 0; i < n; i++)
+			it[i] = imagec[i]/255.f;
+		resdet_stats_add_convert(ctx->stats,start);
+		it += n;
 	}
-	for(size_t i = 0; i < width * height; i++)
-		image[i] = imagec[i]/255.f;
 
 end:
 	ctx->eof = true;
-	free(imagec);
 	return *error == RDEOK;
 }
 
@@ -122,10 +130,15 @@ static bool libjpeg_reader_supports_ext(const char* ext) {
 	return resdet_strieq(ext,"jpg") || resdet_strieq(ext,"jpeg");
 }
 
+static void libjpeg_reader_set_stats(void* reader_ctx, RDStats* stats) {
+	((struct libjpeg_context*)reader_ctx)->stats = stats;
+}
+
 struct image_reader resdet_image_reader_libjpeg = {
-	.open = libjpeg_reader_open,
+	.open_file = libjpeg_reader_open_file,
 	.read_frame = libjpeg_reader_read_frame,
 	.seek_frame = libjpeg_reader_seek_frame,
 	.close = libjpeg_reader_close,
 	.supports_ext = libjpeg_reader_supports_ext,
+	.set_stats = libjpeg_reader_set_stats,
 };
@@ -16,6 +16,9 @@ static void pngerr_warning_fn(png_structp png_ptr, png_const_charp warning_msg)
 struct libpng_context {
 	FILE* f;
 	bool eof;
+	int passes, channels;
+	unsigned char* imagec;
+	RDStats* stats;
 	png_structp png_ptr;
 	png_infop info_ptr;
 };
@@ -27,28 +30,23 @@ static void libpng_reader_close(void* reader_ctx) {
 
 	if(ctx->png_ptr)
 		png_destroy_read_struct(&ctx->png_ptr,&ctx->info_ptr,NULL);
-	if(ctx->f != stdin)
-		fclose(ctx->f);
-	free(ctx);
+	resdet_free(ctx->imagec);
+	resdet_free(ctx);
 }
 
-static void* libpng_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
-	struct libpng_context* ctx = malloc(sizeof(*ctx));
+static void* libpng_reader_open_file(FILE* f, size_t* width, size_t* height, RDError* error) {
+	struct libpng_context* ctx = resdet_malloc(sizeof(*ctx));
 	if(!ctx) {
 		*error = RDENOMEM;
 		return NULL;
 	}
 	ctx->eof = false;
-
-	ctx->f = strcmp(filename,"-") ? fopen(filename,"rb") : stdin;
-	if(!ctx->f) {
-		*error = -errno;
-		free(ctx);
-		return NULL;
-	}
+	ctx->stats = NULL;
+	ctx->f = f;
 
 	ctx->png_ptr = NULL;
 	ctx->info_ptr = NULL;
+	ctx->imagec = NULL;
 
 	unsigned char header[8];
 	if(fread(header,1,8,ctx->f) != 8) {
@@ -94,8 +92,23 @@ static void* libpng_reader_open(const char* filename, size_t* width, size_t* hei
 	else if(bit_depth < 8)
 		png_set_expand_gray_1_2_4_to_8(ctx->png_ptr);
 
+	ctx->passes = png_set_interlace_handling(ctx->png_ptr);
+
 	png_read_update_info(ctx->png_ptr,ctx->info_ptr);
 
+	ctx->channels = png_get_color_type(ctx->png_ptr,ctx->info_ptr) & PNG_COLOR_MASK_COLOR ? 3 : 1;
+
+	// interlaced passes fill in previously read rows so these must be buffered in full,
+	// otherwise only a single scanline is needed
+	if(resdet_dims_exceed_limit(*width,*height,ctx->channels,unsigned char)) {
+		*error = RDETOOBIG;
+		goto error;
+	}
+	if(!(ctx->imagec = resdet_malloc(*width * (ctx->passes > 1 ? *height : 1) * ctx->channels))) {
+		*error = RDENOMEM;
+		goto error;
+	}
+
 	return ctx;
 
 error:
@@ -103,45 +116,52 @@ error:
 	return NULL;
 }
 
+static void convert_row(float* restrict dst, const unsigned char* restrict src, size_t width, int channels) {
+	for(size_t i = 0; i < width; i++) {
+		float sum = 0;
+		for(int c = 0; c < channels; c++)
+			sum += src[i*channels+c]/255.f;
+		dst[i] = sum / channels;
+	}
+}
+
 static bool libpng_reader_read_frame(void* reader_ctx, float* image, size_t width, size_t height, RDError* error) {
 	struct libpng_context* ctx = reader_ctx;
 
 	if(ctx->eof)
 		return false;
 
-	int color = png_get_color_type(ctx->png_ptr,ctx->info_ptr);
-	int channels = color & PNG_COLOR_MASK_COLOR ? 3 : 1;
-	unsigned char* imagec = malloc(width * height * channels);
-	if(!imagec) {
-		*error = RDENOMEM;
-		goto end;
-	}
+	int channels = ctx->channels;
+	unsigned char* imagec = ctx->imagec;
 
 	if(setjmp(png_jmpbuf(ctx->png_ptr))) {
 		*error = RDEINVAL;
 		goto end;
 	}
 
-	int passes = png_set_interlace_handling(ctx->png_ptr);
-
-	for(int i = 0; i < passes; i++) {
-		unsigned char* it = imagec;
-		for(size_t y = 0; y < height; y++, it += width * channels)
-			png_read_row(ctx->png_ptr,it,NULL);
+	if(ctx->passes > 1) {
+		for(int i = 0; i < ctx->passes; i++) {
+			unsigned char* it = imagec;
+			for(size_t y = 0; y < height; y++, it += width * channels)
+				png_read_row(ctx->png_ptr,it,NULL);
+		}
+		uint64_t start = resdet_stats_start(ctx->stats);
+		for(size_t y = 0; y < height; y++)
+			convert_row(image+y*width,imagec+y*width*channels,width,channels);
+		resdet_stats_add_convert(ctx->stats,start);
 	}
+	else
+		for(size_t y = 0; y < height; y++) {
+			png_read_row(ctx->png_ptr,imagec,NULL);
+			uint64_t start = resdet_stats_start(ctx->stats);
+			convert_row(image+y*width,imagec,width,channels);
+			resdet_stats_add_convert(ctx->stats,start);
+		}
 
 	png_read_end(ctx->png_ptr, NULL);
 
-	for(size_t i = 0; i < width * height; i++) {
-		image[i] = 0;
-		for(int c = 0; c < channels; c++)
-			image[i] += imagec[i*channels+c]/255.f;
-		image[i] /= channels;
-	}
-
 end:
 	ctx->eof = true;
-	free(imagec);
 	return *error == RDEOK;
 }
 
@@ -160,11 +180,16 @@ static bool libpng_reader_supports_ext(const char* ext) {
 	return resdet_strieq(ext,"png");
 }
 
+static void libpng_reader_set_stats(void* reader_ctx, RDStats* stats) {
+	((struct libpng_context*)reader_ctx)->stats = stats;
+}
+
 struct image_reader resdet_image_reader_libpng = {
-	.open = libpng_reader_open,
+	.open_file = libpng_reader_open_file,
 	.read_frame = libpng_reader_read_frame,
 	.seek_frame = libpng_reader_seek_frame,
 	.close = libpng_reader_close,
 	.supports_ext = libpng_reader_supports_ext,
+	.set_stats = libpng_reader_set_stats,
 };
 
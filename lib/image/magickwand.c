@@ -3,6 +3,10 @@
  * This file is part of libresdet.
  */
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "image.h"
 
 #if HAVE_MAGICKWAND > 6
@@ -21,46 +25,65 @@ struct magickwand_context {
 	MagickWand* wand;
 };
 
+// NewMagickWand initializes MagickWand on first use, which races when images are opened concurrently.
+#ifdef HAVE_PTHREAD
+static pthread_once_t genesis_once = PTHREAD_ONCE_INIT;
+
+static void magickwand_genesis(void) {
+	MagickWandGenesis();
+}
+#endif
+
 static void magickwand_reader_close(void* reader_ctx) {
 	struct magickwand_context* ctx = reader_ctx;
 	if(ctx) {
 		DestroyMagickWand(ctx->wand);
-		free(ctx);
+		resdet_free(ctx);
 	}
 }
 
-static void* magickwand_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
-	struct magickwand_context* ctx = malloc(sizeof(*ctx));
+// filename is NULL when reading from a FILE
+static RDError rderror_from_wand(MagickWand* wand, const char* filename) {
+	RDError error;
+	ExceptionType ex;
+	char* exception = MagickGetException(wand,&ex);
+	switch(ex) {
+		case BlobError:
+		case FileOpenError: error = -errno; break;
+		case ResourceLimitError:
+		case ResourceLimitFatalError: error = RDENOMEM; break;
+		case MissingDelegateError:
+			if(!filename || !strcmp(filename,"-"))
+				error = RDEUNSUPP;
+			else {
+				FILE* tmp = fopen(filename,"r");
+				if(tmp) {
+					error = RDEUNSUPP;
+					fclose(tmp);
+				}
+				else
+					error = -errno;
+			}
+			break;
+		default: error = RDEINVAL;
+	}
+	RelinquishMagickMemory(exception);
+	return error;
+}
+
+static void* magickwand_open(const char* filename, FILE* f, size_t* width, size_t* height, RDError* error) {
+	struct magickwand_context* ctx = resdet_malloc(sizeof(*ctx));
 	if(!ctx) {
 		*error = RDENOMEM;
 		goto error;
 	}
 
+#ifdef HAVE_PTHREAD
+	pthread_once(&genesis_once,magickwand_genesis);
+#endif
 	ctx->wand = NewMagickWand();
-	if(MagickReadImage(ctx->wand,filename) == MagickFalse) {
-		ExceptionType ex;
-		char* exception = MagickGetException(ctx->wand,&ex);
-		switch(ex) {
-			case BlobError:
-			case FileOpenError: *error = -errno; break;
-			case ResourceLimitError:
-			case ResourceLimitFatalError: *error = RDENOMEM; break;
-			case MissingDelegateError:
-				if(!strcmp(filename,"-"))
-					*error = RDEUNSUPP;
-				else {
-					FILE* tmp = fopen(filename,"r");
-					if(tmp) {
-						*error = RDEUNSUPP;
-						fclose(tmp);
-					}
-					else
-						*error = -errno;
-				}
-				break;
-			default: *error = RDEINVAL;
-		}
-        RelinquishMagickMemory(exception);
+	if((f ? MagickReadImageFile(ctx->wand,f) : MagickReadImage(ctx->wand,filename)) == MagickFalse) {
+		*error = rderror_from_wand(ctx->wand,filename);
 		goto error;
 	}
 
@@ -76,6 +99,14 @@ error:
 	return NULL;
 }
 
+static void* magickwand_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
+	return magickwand_open(filename,NULL,width,height,error);
+}
+
+static void* magickwand_reader_open_file(FILE* f, size_t* width, size_t* height, RDError* error) {
+	return magickwand_open(NULL,f,width,height,error);
+}
+
 static bool magickwand_reader_read_frame(void* reader_ctx, float* image, size_t width, size_t height, RDError* error) {
 	struct magickwand_context* ctx = reader_ctx;
 
@@ -103,6 +134,7 @@ static bool magickwand_reader_supports_ext(const char* ext) {
 
 struct image_reader resdet_image_reader_magickwand = {
 	.open = magickwand_reader_open,
+	.open_file = magickwand_reader_open_file,
 	.read_frame = magickwand_reader_read_frame,
 	.seek_frame = magickwand_reader_seek_frame,
 	.close = magickwand_reader_close,
@@ -9,6 +9,7 @@
 
 struct pfm_context {
 	FILE* f;
+	float* row;
 	float endianness_scale;
 	char format;
 	bool header_consumed;
@@ -16,52 +17,50 @@ struct pfm_context {
 
 #define little_endian() (union { int i; char c; }){1}.c
 
-static bool read_pfm_plane_gray(FILE* f, float* image, size_t width, size_t height, float endianness_scale) {
-	if((endianness_scale < 0) == little_endian()) {
-		for(size_t j = 0; j < height; j++)
-			if(fread(image+(height-j-1)*width,sizeof(float),width,f) < width)
-				return false;
+static void bswap_floats(float* buf, size_t n) {
+	for(size_t i = 0; i < n; i++) {
+		uint32_t v;
+		memcpy(&v,buf+i,sizeof(v));
+		v = (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+		memcpy(buf+i,&v,sizeof(v));
 	}
-	else {
-		for(size_t j = 0; j < height; j++)
-			for(size_t i = 0; i < width; i++) {
-				char buf[4];
-				if(fread(buf,4,1,f) < 1)
-					return false;
-				image[(height-j-1)*width+i] = (union { char c[4]; float f; }){{ buf[3], buf[2], buf[1], buf[0] }}.f;
-			}
+}
+
+// rows are stored bottom-up, read each one directly into place
+static bool read_pfm_plane_gray(FILE* f, float* image, size_t width, size_t height, float endianness_scale) {
+	bool swap = (endianness_scale < 0) != little_endian();
+	for(size_t j = 0; j < height; j++) {
+		float* dst = image+(height-j-1)*width;
+		if(fread(dst,sizeof(float),width,f) < width)
+			return false;
+		if(swap)
+			bswap_floats(dst,width);
 	}
 	return true;
 }
 
-static bool read_pfm_plane_rgb(FILE* f, float* image, size_t width, size_t height, float endianness_scale) {
-    // PF is packed RGB
-	if((endianness_scale < 0) == little_endian()) {
-		for(size_t j = 0; j < height; j++)
-			for(size_t i = 0; i < width; i++) {
-				float pixel[3];
-				if(fread(pixel,sizeof(float),3,f) < 3)
-					return false;
-				image[(height-j-1)*width+i] = (pixel[0] + pixel[1] + pixel[2])/3;
-			}
-	}
-	else {
-		for(size_t j = 0; j < height; j++)
-			for(size_t i = 0; i < width; i++) {
-				char buf[3][4];
-				if(fread(buf,4,3,f) < 3)
-					return false;
-				float pixel[3];
-				for(int c = 0; c < 3; c++)
-					pixel[c] = (union { char c[4]; float f; }){{ buf[c][3], buf[c][2], buf[c][1], buf[c][0] }}.f;
-				image[(height-j-1)*width+i] = (pixel[0] + pixel[1] + pixel[2])/3;
-			}
+static bool read_pfm_plane_rgb(FILE* f, float* image, float* row, size_t width, size_t height, float endianness_scale) {
+	// PF is packed RGB
+	bool swap = (endianness_scale < 0) != little_endian();
+	for(size_t j = 0; j < height; j++) {
+		if(fread(row,sizeof(float)*3,width,f) < width)
+			return false;
+		if(swap)
+			bswap_floats(row,width*3);
+		float* dst = image+(height-j-1)*width;
+		for(size_t i = 0; i < width; i++)
+			dst[i] = (row[i*3] + row[i*3+1] + row[i*3+2])/3;
 	}
 	return true;
 }
 
-static bool read_pfm_plane(FILE* f, float* image, size_t width, size_t height, float endianness_scale, char format) {
-	return format == 'f' ? read_pfm_plane_gray(f,image,width,height,endianness_scale) : read_pfm_plane_rgb(f,image,width,height,endianness_scale);
+// the next frame's header is small enough to fall within the same pages
+static void readahead_frame(struct pfm_context* ctx, size_t width, size_t height) {
+	resdet_freadahead(ctx->f,(uint64_t)width*height*sizeof(float)*(ctx->format == 'F' ? 3 : 1));
+}
+
+static bool read_pfm_plane(struct pfm_context* ctx, float* image, size_t width, size_t height) {
+	return ctx->format == 'f' ? read_pfm_plane_gray(ctx->f,image,width,height,ctx->endianness_scale) : read_pfm_plane_rgb(ctx->f,image,ctx->row,width,height,ctx->endianness_scale);
 }
 
 static void pfm_reader_close(void* reader_ctx) {
@@ -69,9 +68,8 @@ static void pfm_reader_close(void* reader_ctx) {
 	if(!ctx)
 		return;
 
-	if(ctx->f && ctx->f != stdin)
-		fclose(ctx->f);
-	free(ctx);
+	resdet_free(ctx->row);
+	resdet_free(ctx);
 }
 
 static inline bool skip_comments(FILE* f) {
@@ -85,18 +83,15 @@ static inline bool skip_comments(FILE* f) {
 	return c != EOF && ungetc(c,f) == c;
 }
 
-static void* pfm_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
-	struct pfm_context* ctx = malloc(sizeof(*ctx));
+static void* pfm_reader_open_file(FILE* f, size_t* width, size_t* height, RDError* error) {
+	struct pfm_context* ctx = resdet_malloc(sizeof(*ctx));
 	if(!ctx) {
 		*error = RDENOMEM;
 		return NULL;
 	}
 
-	ctx->f = strcmp(filename,"-") ? fopen(filename,"rb") : stdin;
-	if(!ctx->f) {
-		*error = -errno;
-		goto error;
-	}
+	ctx->row = NULL;
+	ctx->f = f;
 
 	if(
 	   fscanf(ctx->f,"P%c",&ctx->format) != 1 ||
@@ -110,7 +105,19 @@ static void* pfm_reader_open(const char* filename, size_t* width, size_t* height
 		goto error;
 	}
 
+	if(resdet_dims_exceed_limit(*width,3,1,float)) {
+		*error = RDETOOBIG;
+		goto error;
+	}
+
+	// scanline buffer for packed RGB, allocated up front since the format may change between frames
+	if(!(ctx->row = resdet_malloc(*width * 3 * sizeof(*ctx->row)))) {
+		*error = RDENOMEM;
+		goto error;
+	}
+
 	ctx->header_consumed = true;
+	readahead_frame(ctx,*width,*height);
 
 	return ctx;
 
@@ -158,12 +165,13 @@ static bool pfm_reader_read_frame(void* reader_ctx, float* image, size_t width,
 	if(!read_header(ctx,width,height,error))
 		return false;
 
-	if(!read_pfm_plane(ctx->f,image,width,height,ctx->endianness_scale,ctx->format)) {
+	if(!read_pfm_plane(ctx,image,width,height)) {
 		*error = RDEINVAL;
 		return false;
 	}
 
 	ctx->header_consumed = false;
+	readahead_frame(ctx,width,height);
 
 	return true;
 }
@@ -177,7 +185,7 @@ static bool pfm_reader_seek_frame(void* reader_ctx, uint64_t offset, void(*progr
 
 	float* buf = NULL;
 	bool seekable = imgsize*sizeof(float) <= (size_t)LONG_MAX && !fseek(ctx->f,0,SEEK_CUR);
-	if(!seekable && !(buf = malloc(imgsize*sizeof(float)))) {
+	if(!seekable && !(buf = resdet_malloc(imgsize*sizeof(float)))) {
 		*error = RDENOMEM;
 		return false;
 	}
@@ -198,9 +206,10 @@ static bool pfm_reader_seek_frame(void* reader_ctx, uint64_t offset, void(*progr
 	}
 
 	ctx->header_consumed = false;
+	readahead_frame(ctx,width,height);
 
 	if(!seekable)
-		free(buf);
+		resdet_free(buf);
 
 	return ret;
 }
@@ -210,7 +219,7 @@ static bool pfm_reader_supports_ext(const char* ext) {
 }
 
 struct image_reader resdet_image_reader_pfm = {
-	.open = pfm_reader_open,
+	.open_file = pfm_reader_open_file,
 	.read_frame = pfm_reader_read_frame,
 	.seek_frame = pfm_reader_seek_frame,
 	.close = pfm_reader_close,
@@ -19,9 +19,7 @@ static void pgm_reader_close(void* reader_ctx) {
 	if(!ctx)
 		return;
 
-	if(ctx->f && ctx->f != stdin)
-		fclose(ctx->f);
-	free(ctx);
+	resdet_free(ctx);
 }
 
 static inline bool skip_comments(FILE* f) {
@@ -35,20 +33,15 @@ static inline bool skip_comments(FILE* f) {
 	return c != EOF && ungetc(c,f) == c;
 }
 
-static void* pgm_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
-	struct pgm_context* ctx = malloc(sizeof(*ctx));
+static void* pgm_reader_open_file(FILE* f, size_t* width, size_t* height, RDError* error) {
+	struct pgm_context* ctx = resdet_malloc(sizeof(*ctx));
 	if(!ctx) {
 		*error = RDENOMEM;
 		return NULL;
 	}
 
 	ctx->eof = false;
-
-	ctx->f = strcmp(filename,"-") ? fopen(filename,"rb") : stdin;
-	if(!ctx->f) {
-		*error = -errno;
-		goto error;
-	}
+	ctx->f = f;
 
 	if(
 	   fscanf(ctx->f,"P5 ") < 0 ||
@@ -61,6 +54,8 @@ static void* pgm_reader_open(const char* filename, size_t* width, size_t* height
 		goto error;
 	}
 
+	resdet_freadahead(ctx->f,(uint64_t)*width * *height);
+
 	return ctx;
 
 error:
@@ -103,7 +98,7 @@ static bool pgm_reader_supports_ext(const char* ext) {
 }
 
 struct image_reader resdet_image_reader_pgm = {
-	.open = pgm_reader_open,
+	.open_file = pgm_reader_open_file,
 	.read_frame = pgm_reader_read_frame,
 	.seek_frame = pgm_reader_seek_frame,
 	.close = pgm_reader_close,
@@ -13,32 +13,32 @@ struct y4m_context {
 	size_t y_plane_size, uv_plane_size;
 	unsigned int depth;
 	bool seekable;
+	RDStats* stats;
 };
 
+// only the luma plane is read, chroma is skipped over when seekable
+static void readahead_frame(struct y4m_context* ctx) {
+	resdet_freadahead(ctx->f,sizeof("FRAME\n")-1 + ctx->y_plane_size);
+}
+
 static void y4m_reader_close(void* reader_ctx) {
 	struct y4m_context* ctx = reader_ctx;
 	if(ctx) {
-		free(ctx->buf);
-		if(ctx->f && ctx->f != stdin)
-			fclose(ctx->f);
-		free(ctx);
+		resdet_free(ctx->buf);
+		resdet_free(ctx);
 	}
 }
 
-static void* y4m_reader_open(const char* filename, size_t* width, size_t* height, RDError* error) {
-	struct y4m_context* ctx = malloc(sizeof(*ctx));
+static void* y4m_reader_open_file(FILE* f, size_t* width, size_t* height, RDError* error) {
+	struct y4m_context* ctx = resdet_malloc(sizeof(*ctx));
 	if(!ctx) {
 		*error = RDENOMEM;
 		goto error;
 	}
 
 	ctx->buf = NULL;
-
-	ctx->f = strcmp(filename,"-") ? fopen(filename,"rb") : stdin;
-	if(!ctx->f) {
-		*error = -errno;
-		goto error;
-	}
+	ctx->stats = NULL;
+	ctx->f = f;
 
 	char magic[10];
 	if(fread(magic,1,10,ctx->f) < 10 || memcmp(magic,"YUV4MPEG2 ",10))
@@ -120,11 +120,13 @@ static void* y4m_reader_open(const char* filename, size_t* width, size_t* height
 	else
 		bufsize = ctx->uv_plane_size < ctx->y_plane_size ? ctx->y_plane_size : ctx->uv_plane_size;
 
-	if(!(ctx->buf = malloc(bufsize))) {
+	if(!(ctx->buf = resdet_malloc(bufsize))) {
 		*error = RDENOMEM;
 		goto error;
 	}
 
+	readahead_frame(ctx);
+
 	return ctx;
 
 error:
@@ -170,6 +172,7 @@ static bool y4m_reader_read_frame(void* reader_ctx, float* image, size_t width,
 		return false;
 	}
 
+	uint64_t start = resdet_stats_start(ctx->stats);
 	float scale = (1u << ctx->depth)-1;
 	for(size_t i = 0; i < width*height; i++) {
 		uint16_t val;
@@ -180,11 +183,14 @@ static bool y4m_reader_read_frame(void* reader_ctx, float* image, size_t width,
 
 		image[i] = val/scale;
 	}
+	resdet_stats_add_convert(ctx->stats,start);
 
 	// skip over u/v planes
 	if((*error = resdet_fskip(ctx->f,ctx->uv_plane_size,ctx->seekable ? NULL : ctx->buf)))
 		return false;
 
+	readahead_frame(ctx);
+
 	return true;
 }
 
@@ -202,6 +208,9 @@ static bool y4m_reader_seek_frame(void* reader_ctx, uint64_t offset, void(*progr
 		if(progress)
 			progress(progress_ctx,i+1);
 	}
+
+	readahead_frame(ctx);
+
 	return true;
 }
 
@@ -209,10 +218,15 @@ static bool y4m_reader_supports_ext(const char* ext) {
 	return resdet_strieq(ext,"y4m");
 }
 
+static void y4m_reader_set_stats(void* reader_ctx, RDStats* stats) {
+	((struct y4m_context*)reader_ctx)->stats = stats;
+}
+
 struct image_reader resdet_image_reader_y4m = {
-	.open = y4m_reader_open,
+	.open_file = y4m_reader_open_file,
 	.read_frame = y4m_reader_read_frame,
 	.seek_frame = y4m_reader_seek_frame,
 	.close = y4m_reader_close,
 	.supports_ext = y4m_reader_supports_ext,
+	.set_stats = y4m_reader_set_stats,
 };
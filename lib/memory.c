@@ -0,0 +1,46 @@
+/*
+ * Large buffer allocation.
+ * This file is part of libresdet.
+ */
+
+#ifdef HAVE_MADV_HUGEPAGE
+#define _DEFAULT_SOURCE
+#include <sys/mman.h>
+#endif
+
+#include "resdet_internal.h"
+
+#define HUGE_PAGE_SIZE ((size_t)2*1024*1024)
+
+/*
+ * Frame sized buffers are only ever touched by the transform and detection passes, never here,
+ * so their pages are placed on the NUMA node of whichever thread first analyzes an image.
+ */
+void* resdet_alloc_large(size_t size, bool huge_pages) {
+#ifdef HAVE_MADV_HUGEPAGE
+	if(huge_pages && size >= HUGE_PAGE_SIZE) {
+		if(size > SIZE_MAX - HUGE_PAGE_SIZE)
+			return NULL;
+		size_t padded = (size + HUGE_PAGE_SIZE-1) & ~(HUGE_PAGE_SIZE-1);
+		void* ptr = resdet_aligned_alloc(HUGE_PAGE_SIZE,padded);
+		if(ptr)
+			madvise(ptr,padded,MADV_HUGEPAGE); // purely advisory, normal pages are fine on failure
+		return ptr;
+	}
+#endif
+	return resdet_aligned_alloc(64,size);
+}
+
+void resdet_free_large(void* ptr) {
+	resdet_aligned_free(ptr);
+}
+
+// For buffers we don't control the alignment of, only the huge page aligned interior can be promoted.
+void resdet_advise_huge_pages(void* ptr, size_t size) {
+#ifdef HAVE_MADV_HUGEPAGE
+	uintptr_t start = ((uintptr_t)ptr + HUGE_PAGE_SIZE-1) & ~(uintptr_t)(HUGE_PAGE_SIZE-1),
+	          end   = ((uintptr_t)ptr + size) & ~(uintptr_t)(HUGE_PAGE_SIZE-1);
+	if(end > start)
+		madvise((void*)start,end-start,MADV_HUGEPAGE);
+#endif
+}
@@ -11,58 +11,138 @@
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 
+/*
+ * Kernels for the range-based methods are generated for a set of common ranges, with the range as a
+ * constant so the inner loop can be fully unrolled, plus a generic version taking the range at runtime.
+ * A build with a DEFAULT_RANGE outside of this set gets an additional kernel for it.
+ */
+#if DEFAULT_RANGE == 1 || DEFAULT_RANGE == 4 || DEFAULT_RANGE == 8 || DEFAULT_RANGE == 12 || DEFAULT_RANGE == 16 || DEFAULT_RANGE == 32
+#define SPECIALIZED_RANGES(X,name,type) X(name,type,1) X(name,type,4) X(name,type,8) X(name,type,12) X(name,type,16) X(name,type,32)
+#else
+#define SPECIALIZED_RANGES(X,name,type) X(name,type,1) X(name,type,4) X(name,type,8) X(name,type,12) X(name,type,16) X(name,type,32) X(name,type,DEFAULT_RANGE)
+#endif
+
+#define DEFINE_KERNEL(name, type, RANGE, suffix) \
+static void name##_kernel_##suffix(const type* restrict f, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index start, rdint_index end) { \
+	for(rdint_index x = start; x < end; x++) { \
+		rdint_storage count = 0; \
+		if(stride == 1) /* lines are contiguous, compare whole spans at each offset */ \
+			for(rdint_index i = 1; i <= (RANGE); i++) { \
+				const type* restrict l = f+x*dist-i*dist,* restrict r = f+x*dist+i*dist; \
+				for(rdint_index y = 0; y < n; y++) \
+					count += name##_test(l[y],r[y]); \
+			} \
+		else \
+			for(rdint_index y = 0; y < n; y++) \
+				for(rdint_index i = 1; i <= (RANGE); i++) \
+					count += name##_test(f[y*stride+x*dist-i*dist],f[y*stride+x*dist+i*dist]); \
+		result[x-start] += count / ((intermediate)n*(RANGE)); \
+	} \
+}
+#define DEFINE_RANGE_KERNEL(name, type, RANGE) DEFINE_KERNEL(name, type, RANGE, RANGE)
+#define KERNEL_CASE(name, type, RANGE) KERNEL_CASE_(name, RANGE)
+#define KERNEL_CASE_(name, RANGE) case RANGE: return name##_kernel_##RANGE;
+
+#define DEFINE_KERNELS(name, type) \
+DEFINE_KERNEL(name, type, range, generic) \
+SPECIALIZED_RANGES(DEFINE_RANGE_KERNEL,name,type) \
+typedef void(*name##_kernel_func)(const type* restrict,size_t,size_t,size_t,size_t,intermediate* restrict,rdint_index,rdint_index); \
+static name##_kernel_func name##_kernel(size_t range) { \
+	switch(range) { \
+		SPECIALIZED_RANGES(KERNEL_CASE,name,type) \
+	} \
+	return name##_kernel_generic; \
+}
+
 // Sweeps the image looking for boundaries with many sign inversions.
 // Fast, simple, and conveniently one of the most accurate methods.
-static RDError detect_method_sign(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end) {
-	for(rdint_index x = *start; x < *end; x++) {
-		rdint_storage sign_diff = 0;
-		for(rdint_index y = 0; y < n; y++)
-			for(rdint_index i = 1; i <= range; i++)
-				sign_diff += coeff_signbit(f[y*stride+x*dist-i*dist]) != coeff_signbit(f[y*stride+x*dist+i*dist]);
-		result[x-*start] += sign_diff / ((intermediate)n*range);
-	}
+static inline bool sign_test(coeff l, coeff r) {
+	return coeff_signbit(l) != coeff_signbit(r);
+}
+
+DEFINE_KERNELS(sign, coeff)
+
+static RDError detect_method_sign(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end, void* restrict state) {
+	sign_kernel(range)(f,n,stride,dist,range,result,*start,*end);
+	return RDEOK;
+}
+
+// bfloat16 keeps the sign bit of the full precision coefficient, so results are identical.
+static inline bool sign_bf16_test(bfloat16 l, bfloat16 r) {
+	return (l ^ r) >> 15;
+}
+
+DEFINE_KERNELS(sign_bf16, bfloat16)
+
+static RDError detect_method_sign_bf16(const bfloat16* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end, void* restrict state) {
+	sign_bf16_kernel(range)(f,n,stride,dist,range,result,*start,*end);
 	return RDEOK;
 }
 
 // Looks for similar magnitude coefficients with inverted signs.
-static RDError detect_method_magnitude(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end) {
-	for(rdint_index x = *start; x < *end; x++) {
-		rdint_storage mag_match = 0;
-		for(rdint_index y = 0; y < n; y++)
-			for(rdint_index i = 1; i <= range; i++) {
-				int e;
-				mi(frexp)(f[y*stride+x*dist-i*dist]/mc(copysign)(MAX(mc(fabs)(f[y*stride+x*dist+i*dist]),EPSILON),f[y*stride+x*dist+i*dist])+1,&e);
-				mag_match += e <= 0;
-			}
-		result[x-*start] += mag_match / ((intermediate)n*range);
-	}
+static inline bool magnitude_test(coeff l, coeff r) {
+	int e;
+	mi(frexp)(l/mc(copysign)(MAX(mc(fabs)(r),EPSILON),r)+1,&e);
+	return e <= 0;
+}
+
+DEFINE_KERNELS(magnitude, coeff)
+
+static RDError detect_method_magnitude(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end, void* restrict state) {
+	magnitude_kernel(range)(f,n,stride,dist,range,result,*start,*end);
+	return RDEOK;
+}
+
+// Magnitude ratios are only resolved to bfloat16's 8 bits of mantissa, so results are approximate.
+static inline bool magnitude_bf16_test(bfloat16 l, bfloat16 r) {
+	return magnitude_test(bf16_to_coeff(l),bf16_to_coeff(r));
+}
+
+DEFINE_KERNELS(magnitude_bf16, bfloat16)
+
+static RDError detect_method_magnitude_bf16(const bfloat16* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end, void* restrict state) {
+	magnitude_bf16_kernel(range)(f,n,stride,dist,range,result,*start,*end);
 	return RDEOK;
 }
 
-// Initial algorithm. Somewhat more complicated mixture of the previous.
-// Tests for inverted sign, same magnitude, with lower magnitude/zero crossing in between.
-// Confidence value is the same as detect_method_sign, but results not matching the expected magnitudes are suppressed
-static RDError detect_method_original(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end) {
 #ifndef MAG_RANGE
 #define MAG_RANGE range
 #endif
 
+// Narrows the bounds to what the original method can evaluate and sets up its per-line magnitude sums,
+// which are reused for every image in the analysis.
+static RDError init_method_original(size_t length, size_t n, size_t range, rdint_index* restrict start, rdint_index* restrict end, void** state) {
 	rdint_index maxrange = MAX(MAG_RANGE,range);
 	if(maxrange*2 >= length)
 		return RDEOK; //can't do anything
 
-	intermediate* sum = NULL;
-	if(!(sum = calloc(length,sizeof(*sum))))
+	if(!(*state = resdet_malloc(length*sizeof(intermediate))))
 		return RDENOMEM;
 
 	*start = maxrange;
 	*end = length-maxrange;
+	return RDEOK;
+}
+
+static void teardown_method_original(void* state) {
+	resdet_free(state);
+}
+
+// Initial algorithm. Somewhat more complicated mixture of the previous.
+// Tests for inverted sign, same magnitude, with lower magnitude/zero crossing in between.
+// Confidence value is the same as detect_method_sign, but results not matching the expected magnitudes are suppressed
+static RDError detect_method_original(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end, void* restrict state) {
+	intermediate* sum = state;
+	if(!sum)
+		return RDEOK;
+
+	memset(sum,0,length*sizeof(*sum));
 	for(rdint_index y = 0; y < n; y++)
 		for(rdint_index x = 0; x < length; x++)
 			sum[x] += mi(fabs)(f[y*stride+x*dist]);
 	for(rdint_index x = 0; x < length; x++)
 		sum[x] /= n;
-	for(rdint_index x = maxrange; x < length-maxrange; x++) {
+	for(rdint_index x = *start; x < *end; x++) {
 		intermediate left = 0, right = 0, mid = sum[x] * MAG_RANGE;
 		for(rdint_index i = 1; i <= MAG_RANGE; i++) {
 			left += sum[x-i];
@@ -78,13 +158,12 @@ static RDError detect_method_original(const coeff* restrict f, size_t length, si
 		}
 	}
 
-	free(sum);
 	return RDEOK;
 }
 
 // Lightweight version of original method
 // Disregards range, only checks explicitly for zero crossings over all 3-element spans
-static RDError detect_method_zerocrossing(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end) {
+static RDError detect_method_zerocrossing(const coeff* restrict f, size_t length, size_t n, size_t stride, size_t dist, size_t range, intermediate* restrict result, rdint_index* restrict start, rdint_index* restrict end, void* restrict state) {
 	for(rdint_index x = *start; x < *end; x++) {
 		rdint_storage zero_crossings = 0;
 		for(rdint_index y = 0; y < n; y++) {
@@ -108,7 +187,9 @@ static RDMethod methods[] = {
 	},{
 		.name = "orig",
 		.func = (void(*)(void))detect_method_original,
-		.threshold = 0.64
+		.threshold = 0.64,
+		.init = (void(*)(void))init_method_original,
+		.teardown = (void(*)(void))teardown_method_original
 	},{
 		.name = "zerox",
 		.func = (void(*)(void))detect_method_zerocrossing,
@@ -120,3 +201,11 @@ static RDMethod methods[] = {
 RESDET_API RDMethod* resdet_methods(void) {
 	return methods;
 }
+
+RDetectBF16Func resdet_bf16_method(RDMethod* method) {
+	if(method->func == (void(*)(void))detect_method_sign)
+		return detect_method_sign_bf16;
+	if(method->func == (void(*)(void))detect_method_magnitude)
+		return detect_method_magnitude_bf16;
+	return NULL;
+}
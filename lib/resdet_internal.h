@@ -59,10 +59,40 @@ typedef size_t rdint_storage;
 
 typedef struct resdet_plan resdet_plan;
 
+// Upper half of an IEEE single precision float, used as a compact coefficient format by some methods
+typedef uint16_t bfloat16;
+
+static inline bfloat16 coeff_to_bf16(coeff c) {
+	float f = c;
+	uint32_t bits;
+	memcpy(&bits,&f,sizeof(bits));
+	bits += 0x7FFF + ((bits >> 16) & 1); // round to nearest even
+	return bits >> 16;
+}
+
+static inline coeff bf16_to_coeff(bfloat16 b) {
+	uint32_t bits = (uint32_t)b << 16;
+	float f;
+	memcpy(&f,&bits,sizeof(f));
+	return f;
+}
+
+typedef RDError(*RDetectFunc)(const coeff* restrict,size_t,size_t,size_t,size_t,size_t,intermediate* restrict,rdint_index* restrict,rdint_index* restrict,void* restrict);
+typedef RDError(*RDetectInitFunc)(size_t,size_t,size_t,rdint_index* restrict,rdint_index* restrict,void**);
+typedef void(*RDetectTeardownFunc)(void*);
+typedef RDError(*RDetectBF16Func)(const bfloat16* restrict,size_t,size_t,size_t,size_t,size_t,intermediate* restrict,rdint_index* restrict,rdint_index* restrict,void* restrict);
+
 struct RDParameters {
 	size_t range;
 	float threshold;
 	uint8_t compression_filter;
+	bool huge_pages;
+	bool bf16_coeffs;
+	float coarse_fraction;
+	size_t line_step;
+	bool random_line_offset;
+	bool widths, heights;
+	bool stats;
 };
 
 struct RDAnalysis {
@@ -72,20 +102,69 @@ struct RDAnalysis {
 	RDParameters params;
 	coeff* f;
 	resdet_plan* p;
+	// coarse mode: p transforms sample_rows full width rows, col_p sample_cols full height columns
+	bool coarse;
+	resdet_plan* col_p;
+	size_t sample_rows, sample_cols;
 	intermediate* xresult,* yresult;
 	rdint_index xbound[2], ybound[2];
+	// offsets into each result currently passing the threshold and compression filter, refreshed per image
+	rdint_index* xcandidates,* ycandidates;
+	size_t nxcandidates, nycandidates;
+	void* xstate,* ystate;
+	RDetectBF16Func bf16_func;
+	uint32_t line_seed;
+	RDStats stats;
 };
 
 static const RDParameters default_params = {
 	.range = DEFAULT_RANGE,
-	.threshold = -1
+	.threshold = -1,
+	.coarse_fraction = 1,
+	.line_step = 1,
+	.widths = true,
+	.heights = true
 };
 
-typedef RDError(*RDetectFunc)(const coeff* restrict,size_t,size_t,size_t,size_t,size_t,intermediate* restrict,rdint_index* restrict,rdint_index* restrict);
+RDetectBF16Func resdet_bf16_method(RDMethod*);
+
+uint64_t resdet_time_ns(void);
+
+// Timing for optional instrumentation, only reading the clock when stats is non-NULL.
+static inline uint64_t resdet_stats_start(const RDStats* stats) {
+	return stats ? resdet_time_ns() : 0;
+}
+
+static inline void resdet_stats_add(RDStats* stats, enum RDStage stage, uint64_t start) {
+	if(stats) {
+		stats->stages[stage].ns += resdet_time_ns() - start;
+		stats->stages[stage].count++;
+	}
+}
+
+void* resdet_malloc(size_t);
+void* resdet_calloc(size_t,size_t);
+void resdet_free(void*);
+void* resdet_aligned_alloc(size_t,size_t);
+void resdet_aligned_free(void*);
+
+void* resdet_alloc_large(size_t,bool);
+void resdet_free_large(void*);
+void resdet_advise_huge_pages(void*,size_t);
+
+// 1D passes of the transform to run, rows followed by columns when both are set
+enum {
+	RESDET_TRANSFORM_ROWS = 1,
+	RESDET_TRANSFORM_COLUMNS = 2,
+	RESDET_TRANSFORM_2D = RESDET_TRANSFORM_ROWS | RESDET_TRANSFORM_COLUMNS,
+	// plan each pass on its own so they can be run one at a time with resdet_transform_pass
+	RESDET_TRANSFORM_SEPARATE = 4
+};
 
-coeff* resdet_alloc_coeffs(size_t,size_t);
-resdet_plan* resdet_create_plan(coeff*, size_t, size_t, RDError*);
+coeff* resdet_alloc_coeffs(size_t,size_t,bool);
+resdet_plan* resdet_create_plan(coeff*, size_t, size_t, unsigned, RDError*);
 void resdet_transform(resdet_plan*);
+void resdet_transform_pass(resdet_plan*, unsigned);
 void resdet_free_plan(resdet_plan*);
 void resdet_free_coeffs(coeff*);
 
@@ -55,6 +55,9 @@ RESDET_API RDError resdetect_file(const char* filename, const char* filetype,
 	if(error)
 		return error;
 
+	if(params && params->huge_pages)
+		resdet_advise_huge_pages(image,width*height*sizeof(*image));
+
 	RDAnalysis* analysis = resdet_create_analysis(method,width,height,params,&error);
 	if(error)
 		goto end;
@@ -3,30 +3,72 @@
  * This file is part of libresdet.
  */
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 #include "resdet_internal.h"
 #include <fftw3.h>
 
+/*
+ * FFTW's planner has global state and isn't thread safe, while execution is.
+ * resdetect_files creates analyses from several threads at once, so planning and plan destruction
+ * are serialized here rather than leaving it to callers to prepare FFTW.
+ */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t planner_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock_planner(void) {
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&planner_lock);
+#endif
+}
+
+static void unlock_planner(void) {
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&planner_lock);
+#endif
+}
+
+// A 2D transform is normally one plan, or a plan per pass when planned with RESDET_TRANSFORM_SEPARATE
 struct resdet_plan {
 	fftwp(plan) plan;
+	fftwp(plan) rows, columns;
 };
 
-coeff* resdet_alloc_coeffs(size_t width, size_t height) {
-	return fftwp(alloc_real)(width*height);
+coeff* resdet_alloc_coeffs(size_t width, size_t height, bool huge_pages) {
+	return resdet_alloc_large(sizeof(coeff)*width*height,huge_pages);
 }
 
-resdet_plan* resdet_create_plan(coeff* f, size_t width, size_t height, RDError* error) {
+resdet_plan* resdet_create_plan(coeff* f, size_t width, size_t height, unsigned passes, RDError* error) {
 	if(width > INT_MAX || height > INT_MAX) {
 		*error = RDETOOBIG;
 		return NULL;
 	}
 
-	resdet_plan* p = malloc(sizeof(*p));
+	resdet_plan* p = resdet_calloc(1,sizeof(*p));
 	if(!p) {
 		*error = RDENOMEM;
 		return NULL;
 	}
 
-	if(!(p->plan = fftwp(plan_r2r_2d)(height,width,f,f,FFTW_REDFT10,FFTW_REDFT10,FFTW_ESTIMATE))) {
+	fftwp(r2r_kind) kind = FFTW_REDFT10;
+	int rown[] = { width }, columnn[] = { height };
+	bool failed;
+	lock_planner();
+	if((passes & RESDET_TRANSFORM_2D) == RESDET_TRANSFORM_2D && !(passes & RESDET_TRANSFORM_SEPARATE))
+		failed = !(p->plan = fftwp(plan_r2r_2d)(height,width,f,f,FFTW_REDFT10,FFTW_REDFT10,FFTW_ESTIMATE));
+	else {
+		if(passes & RESDET_TRANSFORM_ROWS)
+			p->rows = fftwp(plan_many_r2r)(1,rown,height,f,NULL,1,width,f,NULL,1,width,&kind,FFTW_ESTIMATE);
+		if(passes & RESDET_TRANSFORM_COLUMNS)
+			p->columns = fftwp(plan_many_r2r)(1,columnn,width,f,NULL,width,1,f,NULL,width,1,&kind,FFTW_ESTIMATE);
+		failed = ((passes & RESDET_TRANSFORM_ROWS) && !p->rows) || ((passes & RESDET_TRANSFORM_COLUMNS) && !p->columns);
+	}
+	unlock_planner();
+
+	if(failed) {
 		resdet_free_plan(p);
 		*error = RDEINTERNAL;
 		return NULL;
@@ -37,16 +79,33 @@ resdet_plan* resdet_create_plan(coeff* f, size_t width, size_t height, RDError*
 }
 
 void resdet_transform(resdet_plan* p) {
-	fftwp(execute)(p->plan);
+	if(p->plan)
+		fftwp(execute)(p->plan);
+	else
+		resdet_transform_pass(p,RESDET_TRANSFORM_2D);
+}
+
+// Only plans created with RESDET_TRANSFORM_SEPARATE, or with a single pass, can run their passes individually.
+void resdet_transform_pass(resdet_plan* p, unsigned passes) {
+	if((passes & RESDET_TRANSFORM_ROWS) && p->rows)
+		fftwp(execute)(p->rows);
+	if((passes & RESDET_TRANSFORM_COLUMNS) && p->columns)
+		fftwp(execute)(p->columns);
 }
 
 void resdet_free_plan(resdet_plan* p) {
 	if(p) {
+		lock_planner();
 		if(p->plan)
 			fftwp(destroy_plan)(p->plan);
-		free(p);
+		if(p->rows)
+			fftwp(destroy_plan)(p->rows);
+		if(p->columns)
+			fftwp(destroy_plan)(p->columns);
+		unlock_planner();
+		resdet_free(p);
 	}
 }
 void resdet_free_coeffs(coeff* f) {
-	fftwp(free)(f);
+	resdet_free_large(f);
 }
@@ -0,0 +1,86 @@
+/*
+ * Batched SSE transforms for the KISS FFT backend.
+ * Built against KISS FFT's USE_SIMD variant, where each scalar is an __m128 holding the same
+ * position from 4 independent lines, so one FFT call transforms 4 rows or columns at a time.
+ * This file is part of libresdet.
+ */
+
+#include "kiss_fft_simd.h"
+#include "kiss_fftr.h"
+
+// precision.h undefines its precision names, so coeff's size is checked instead.
+// The SIMD KISS FFT backend requires single precision coefficients.
+typedef char kiss_simd_requires_float_coeffs[sizeof(coeff) == sizeof(float) ? 1 : -1];
+
+#define LANES 4
+
+struct kiss_simd_plan {
+	kiss_fftr_cfg cfg;
+	kiss_fft_scalar* mirror;
+	kiss_fft_cpx* F;
+};
+
+kiss_simd_plan* kiss_simd_create_plan(size_t length) {
+	size_t cfgsize = 0;
+	kiss_fftr_alloc(length*2,false,NULL,&cfgsize);
+
+	kiss_simd_plan* p;
+	if(!((p         = resdet_calloc(1,sizeof(*p))                                          ) &&
+	     (p->mirror = resdet_aligned_alloc(16,sizeof(kiss_fft_scalar)*length*2)) &&
+	     (p->F      = resdet_aligned_alloc(16,sizeof(kiss_fft_cpx)*(length+1))  ) &&
+	     (p->cfg    = resdet_aligned_alloc(16,cfgsize)                          ) &&
+	     kiss_fftr_alloc(length*2,false,p->cfg,&cfgsize)
+	)) {
+		kiss_simd_free_plan(p);
+		return NULL;
+	}
+	return p;
+}
+
+// Transforms n lines of the given length, where element i of line j is at f[j*dist+i*stride].
+// Groups of 4 adjacent columns (dist == 1) are loaded directly, anything else goes through a small gather.
+void kiss_simd_dct(kiss_simd_plan* p, coeff* restrict f, const float* restrict shift, size_t n, size_t length, size_t stride, size_t dist) {
+	kiss_fft_scalar* restrict mirror = p->mirror;
+	kiss_fft_cpx* restrict F = p->F;
+
+	for(size_t j = 0; j < n; j += LANES) {
+		size_t lanes = n-j < LANES ? n-j : LANES;
+		bool contiguous = dist == 1 && lanes == LANES;
+		float lane[LANES] = {0};
+
+		for(size_t i = 0; i < length; i++) {
+			const coeff* restrict in = f+j*dist+i*stride;
+			if(contiguous)
+				mirror[i] = _mm_loadu_ps(in);
+			else {
+				for(size_t l = 0; l < lanes; l++)
+					lane[l] = in[l*dist];
+				mirror[i] = _mm_loadu_ps(lane);
+			}
+			mirror[length*2-1-i] = mirror[i];
+		}
+
+		kiss_fftr(p->cfg,mirror,F);
+
+		for(size_t i = 0; i < length; i++) {
+			coeff* restrict out = f+j*dist+i*stride;
+			__m128 v = _mm_sub_ps(_mm_mul_ps(F[i].r,_mm_set1_ps(shift[i*2])),_mm_mul_ps(F[i].i,_mm_set1_ps(shift[i*2+1])));
+			if(contiguous)
+				_mm_storeu_ps(out,v);
+			else {
+				_mm_storeu_ps(lane,v);
+				for(size_t l = 0; l < lanes; l++)
+					out[l*dist] = lane[l];
+			}
+		}
+	}
+}
+
+void kiss_simd_free_plan(kiss_simd_plan* p) {
+	if(p) {
+		resdet_aligned_free(p->cfg);
+		resdet_aligned_free(p->F);
+		resdet_aligned_free(p->mirror);
+		resdet_free(p);
+	}
+}
@@ -0,0 +1,17 @@
+/*
+ * Batched SSE transforms for the KISS FFT backend.
+ * This file is part of libresdet.
+ */
+
+#ifndef KISS_FFT_SIMD_H
+#define KISS_FFT_SIMD_H
+
+#include "resdet_internal.h"
+
+typedef struct kiss_simd_plan kiss_simd_plan;
+
+kiss_simd_plan* kiss_simd_create_plan(size_t length);
+void kiss_simd_dct(kiss_simd_plan*, coeff* restrict f, const float* restrict shift, size_t n, size_t length, size_t stride, size_t dist);
+void kiss_simd_free_plan(kiss_simd_plan*);
+
+#endif
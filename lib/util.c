@@ -47,6 +47,130 @@ RESDET_API RDError resdet_parameters_set_compression_filter(RDParameters* params
 	return RDEOK;
 }
 
+RESDET_API RDError resdet_parameters_set_coarse_fraction(RDParameters* params, float fraction) {
+	if(!params || !(fraction > 0 && fraction <= 1))
+		return RDEPARAM;
+
+	params->coarse_fraction = fraction;
+	return RDEOK;
+}
+
+RESDET_API RDError resdet_parameters_set_line_sampling(RDParameters* params, size_t step, bool random_offset) {
+	if(!params || !step)
+		return RDEPARAM;
+
+	params->line_step = step;
+	params->random_line_offset = random_offset;
+	return RDEOK;
+}
+
+RESDET_API RDError resdet_parameters_set_axes(RDParameters* params, bool widths, bool heights) {
+	if(!params || !(widths || heights))
+		return RDEPARAM;
+
+	params->widths = widths;
+	params->heights = heights;
+	return RDEOK;
+}
+
+RESDET_API RDError resdet_parameters_set_stats(RDParameters* params, bool enable) {
+	if(!params)
+		return RDEPARAM;
+
+	params->stats = enable;
+	return RDEOK;
+}
+
+RESDET_API RDError resdet_parameters_set_huge_pages(RDParameters* params, bool enable) {
+	if(!params)
+		return RDEPARAM;
+
+#ifndef HAVE_MADV_HUGEPAGE
+	// RDEUNSUPP would read as an unsupported file format
+	if(enable)
+		return RDEPARAM;
+#endif
+	params->huge_pages = enable;
+	return RDEOK;
+}
+
+
+static void* default_malloc(void* opaque, size_t size) {
+	return malloc(size);
+}
+
+static void default_free(void* opaque, void* ptr) {
+	free(ptr);
+}
+
+static const RDAllocator default_allocator = {
+	.malloc_fn = default_malloc,
+	.free_fn = default_free
+};
+
+static RDAllocator allocator = default_allocator;
+
+RESDET_API RDError resdet_set_allocator(const RDAllocator* new_allocator) {
+	if(!new_allocator) {
+		allocator = default_allocator;
+		return RDEOK;
+	}
+
+	if(!(new_allocator->malloc_fn && new_allocator->free_fn))
+		return RDEPARAM;
+
+	allocator = *new_allocator;
+	return RDEOK;
+}
+
+void* resdet_malloc(size_t size) {
+	return allocator.malloc_fn(allocator.opaque,size);
+}
+
+void* resdet_calloc(size_t nmemb, size_t size) {
+	if(allocator.calloc_fn)
+		return allocator.calloc_fn(allocator.opaque,nmemb,size);
+
+	if(size && nmemb > SIZE_MAX/size)
+		return NULL;
+	void* ptr = resdet_malloc(nmemb*size);
+	if(ptr)
+		memset(ptr,0,nmemb*size);
+	return ptr;
+}
+
+void resdet_free(void* ptr) {
+	if(ptr)
+		allocator.free_fn(allocator.opaque,ptr);
+}
+
+/*
+ * Without an aligned_alloc_fn we over-allocate through malloc_fn and stash the
+ * original pointer just below the aligned block so resdet_aligned_free can find it.
+ * alignment must be a power of two no smaller than sizeof(void*).
+ */
+void* resdet_aligned_alloc(size_t alignment, size_t size) {
+	if(allocator.aligned_alloc_fn)
+		return allocator.aligned_alloc_fn(allocator.opaque,alignment,size);
+
+	if(size > SIZE_MAX - alignment - sizeof(void*))
+		return NULL;
+	unsigned char* base = resdet_malloc(size + alignment + sizeof(void*));
+	if(!base)
+		return NULL;
+	uintptr_t addr = ((uintptr_t)(base + sizeof(void*)) + alignment-1) & ~(uintptr_t)(alignment-1);
+	((void**)addr)[-1] = base;
+	return (void*)addr;
+}
+
+void resdet_aligned_free(void* ptr) {
+	if(!ptr)
+		return;
+	if(allocator.aligned_alloc_fn)
+		allocator.free_fn(allocator.opaque,ptr);
+	else
+		resdet_free(((void**)ptr)[-1]);
+}
 
 RESDET_API size_t resdet_default_range(void) {
 	return DEFAULT_RANGE;
@@ -81,3 +205,21 @@ RESDET_API const char* resdet_error_str(RDError e) {
 RESDET_API enum RDErrors resdet_get_max_error(void) {
 	return sizeof(RDErrStr)/sizeof(*RDErrStr)-1;
 }
+
+static const char* const RDStageStr[] = {
+	[RDSTAGE_DECODE]           = "decode",
+	[RDSTAGE_CONVERT]          = "convert",
+	[RDSTAGE_COPY]             = "copy",
+	[RDSTAGE_ROW_TRANSFORM]    = "row transform",
+	[RDSTAGE_COLUMN_TRANSFORM] = "column transform",
+	[RDSTAGE_DETECT_X]         = "detect x",
+	[RDSTAGE_DETECT_Y]         = "detect y",
+	[RDSTAGE_RESULTS]          = "results",
+};
+
+RESDET_API const char* resdet_stage_name(enum RDStage stage) {
+	if(stage >= RDSTAGE_COUNT)
+		return NULL;
+
+	return RDStageStr[stage];
+}
@@ -4,26 +4,108 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <math.h>
 #include <sys/resource.h>
 #include <errno.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
 
-#include "resdet.h"
+// for the bfloat16 coefficient experiment, which isn't part of the public API
+#include "resdet_internal.h"
 
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 
-struct timeval diffts(struct timeval start, struct timeval end) {
-	return end.tv_usec-start.tv_usec < 0 ? (struct timeval){
-		.tv_sec = end.tv_sec-start.tv_sec-1,
-		.tv_usec = 1000000+end.tv_usec-start.tv_usec
-	} : (struct timeval){
-		.tv_sec = end.tv_sec-start.tv_sec,
-		.tv_usec = end.tv_usec-start.tv_usec
-	};
+static const struct bucket {
+	const char* name;
+	size_t max_pixels;
+} buckets[] = {
+	{ "<=480p",  854*480   },
+	{ "<=720p",  1280*720  },
+	{ "<=1080p", 1920*1080 },
+	{ "<=2160p", 3840*2160 },
+	{ ">2160p",  SIZE_MAX  }
+};
+#define NBUCKETS (sizeof(buckets)/sizeof(*buckets))
+
+static const unsigned percentiles[] = { 50, 95, 99 };
+#define NPERCENTILES (sizeof(percentiles)/sizeof(*percentiles))
+
+struct run {
+	RDError error;
+	uint64_t cpu_ns, wall_ns;
+	size_t peak_heap;
+	size_t plus, minus, known;
+};
+
+struct entry {
+	char* filename;
+	size_t* knownw,* knownh;
+	size_t knownwct, knownhct;
+	size_t width, height, frames;
+	RDError error;
+	struct run* runs;
+	bool done;
+};
+
+struct profile {
+	struct entry* entries;
+	size_t nentries, next, printed;
+	RDMethod* methods;
+	RDParameters** variants;
+	const char** suffixes;
+	size_t nvariants, nruns, bf16_variant;
+	int padding;
+	bool json;
+	int ret;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t lock;
+#endif
+};
+
+/*
+ * libresdet's heap is counted per thread through a custom allocator, so each run's peak is its own
+ * even when images are profiled in parallel. Process RSS can only give the peak of all of them at once.
+ */
+static THREAD_LOCAL size_t heap_current, heap_peak;
+
+typedef union {
+	size_t size;
+	long double ld;
+	void* p;
+} alloc_header;
+
+static void* counting_malloc(void* opaque, size_t size) {
+	if(size > SIZE_MAX - sizeof(alloc_header))
+		return NULL;
+	alloc_header* h = malloc(sizeof(*h) + size);
+	if(!h)
+		return NULL;
+	h->size = size;
+	heap_current += size;
+	heap_peak = MAX(heap_peak,heap_current);
+	return h+1;
 }
 
+static void counting_free(void* opaque, void* ptr) {
+	alloc_header* h = (alloc_header*)ptr - 1;
+	heap_current -= h->size;
+	free(h);
+}
+
+static uint64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock,&ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
 void diffres(size_t* left, size_t leftlen, RDResolution* right, size_t rightlen, size_t* plus, size_t* minus) {
 	size_t l = 0, r = 0;
@@ -69,10 +151,430 @@ error:
 	*ct = 0;
 }
 
+static void free_entries(struct entry* entries, size_t nentries) {
+	for(size_t i = 0; i < nentries; i++) {
+		free(entries[i].filename);
+		free(entries[i].knownw);
+		free(entries[i].knownh);
+		free(entries[i].runs);
+	}
+	free(entries);
+}
+
+// Reads every filename and its known widths and heights up front, so images can be handed out to workers.
+static bool read_dict(FILE* dict, size_t nruns, struct entry** entries, size_t* nentries) {
+	*entries = NULL;
+	*nentries = 0;
+	ssize_t len;
+	size_t len2;
+	char* line = NULL;
+	bool ret = false;
+	while((len = getline(&line,&len2,dict)) > 0) {
+		if(*line == '\n')
+			continue;
+		line[len-1] = '\0';
+
+		struct entry* tmp = realloc(*entries,sizeof(**entries)*(*nentries+1));
+		if(!tmp)
+			goto end;
+		*entries = tmp;
+		struct entry* e = *entries + (*nentries)++;
+		memset(e,0,sizeof(*e));
+		if(!((e->filename = strdup(line)) && (e->runs = calloc(nruns,sizeof(*e->runs)))))
+			goto end;
+
+		if((len = getline(&line,&len2,dict)) <= 0)
+			goto end;
+		line[len-1] = '\0';
+		readres(line,&e->knownw,&e->knownwct);
+
+		if((len = getline(&line,&len2,dict)) <= 0)
+			goto end;
+		line[len-1] = '\0';
+		readres(line,&e->knownh,&e->knownhct);
+
+		if(!(e->knownwct && e->knownhct))
+			goto end;
+	}
+	ret = true;
+
+end:
+	free(line);
+	return ret;
+}
+
+// resdetect over a frame store, so long clips are never copied into one contiguous buffer
+static RDError detect_frames(const RDFrames* frames, size_t nframes, size_t width, size_t height,
+                             RDResolution** rw, size_t* cw, RDResolution** rh, size_t* ch,
+                             RDMethod* method, const RDParameters* params) {
+	if(!nframes)
+		return RDENOIMG;
+
+	RDError error;
+	RDAnalysis* analysis = resdet_create_analysis(method,width,height,params,&error);
+	if(!analysis)
+		return error;
+
+	for(size_t i = 0; i < nframes && !error; i++)
+		error = resdet_analyze_image(analysis,resdet_get_frame(frames,i));
+
+	if(!error)
+		error = resdet_analysis_results(analysis,rw,cw,rh,ch);
+
+	resdet_destroy_analysis(analysis);
+	return error;
+}
+
+// Methods without bfloat16 kernels ignore the setting, so their bf16 variant would just repeat the default run.
+static bool run_skipped(const struct profile* p, size_t i) {
+	return p->bf16_variant && i % p->nvariants == p->bf16_variant && !resdet_bf16_method(p->methods + i / p->nvariants);
+}
+
+static void profile_entry(struct profile* p, struct entry* e) {
+	RDFrames* frames = resdet_read_frames(e->filename,NULL,&e->width,&e->height,&e->frames,&e->error);
+	if(!frames)
+		return;
+
+	for(size_t i = 0; i < p->nruns; i++) {
+		if(run_skipped(p,i))
+			continue;
+		struct run* run = e->runs + i;
+		RDMethod* m = p->methods + i / p->nvariants;
+		RDResolution* rw = NULL,* rh = NULL;
+		size_t cw = 0, ch = 0;
+
+		size_t heap_base = heap_current;
+		heap_peak = heap_current;
+		uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID), wall = clock_ns(CLOCK_MONOTONIC);
+		run->error = detect_frames(frames,e->frames,e->width,e->height,&rw,&cw,&rh,&ch,m,p->variants[i % p->nvariants]);
+		run->wall_ns = clock_ns(CLOCK_MONOTONIC) - wall;
+		run->cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+		run->peak_heap = heap_peak - heap_base;
+
+		if(!run->error) {
+			diffres(e->knownw,e->knownwct,rw,cw-1,&run->plus,&run->minus);
+			diffres(e->knownh,e->knownhct,rh,ch-1,&run->plus,&run->minus);
+			run->known = e->knownwct + e->knownhct;
+		}
+		free(rw);
+		free(rh);
+	}
+
+	resdet_free_frames(frames);
+}
+
+static void print_json_string(const char* str) {
+	putchar('"');
+	for(; *str; str++) {
+		unsigned char c = *str;
+		if(c == '"' || c == '\\')
+			printf("\\%c",c);
+		else if(c < 0x20)
+			printf("\\u%04x",c);
+		else putchar(c);
+	}
+	putchar('"');
+}
+
+static void print_ratio(double num, double den) {
+	if(den)
+		printf("%.4f",num/den);
+	else fputs("null",stdout);
+}
+
+static void print_text_run(const struct profile* p, size_t i, uint64_t cpu_ns, uint64_t wall_ns, size_t peak_heap, size_t plus, size_t minus) {
+	const char* name = p->methods[i / p->nvariants].name;
+	printf("%s%-*s   %2llu.%09llu   %2llu.%09llu   %8zu KiB   (+%zu -%zu)",
+	       name,p->padding-(int)strlen(name),p->suffixes[i % p->nvariants],
+	       (unsigned long long)(cpu_ns/1000000000),(unsigned long long)(cpu_ns%1000000000),
+	       (unsigned long long)(wall_ns/1000000000),(unsigned long long)(wall_ns%1000000000),
+	       (peak_heap+1023)/1024,plus,minus);
+}
+
+// Entries are printed in dictionary order as soon as they and every one before them are done.
+static void print_entry(struct profile* p, const struct entry* e) {
+	if(e->error) {
+		fprintf(stderr,"Error reading %s: %s\n",e->filename,resdet_error_str(e->error));
+		if(!p->json)
+			puts(e->filename);
+		return;
+	}
+	if(p->json)
+		return;
+
+	puts(e->filename);
+	for(size_t i = 0; i < p->nruns; i++) {
+		const struct run* run = e->runs + i;
+		if(run_skipped(p,i))
+			continue;
+		if(run->error) {
+			fprintf(stderr,"Error during detection: %s\n",resdet_error_str(run->error));
+			continue;
+		}
+		print_text_run(p,i,run->cpu_ns,run->wall_ns,run->peak_heap,run->plus,run->minus);
+		putchar('\n');
+	}
+}
+
+static void finish_entry(struct profile* p, struct entry* e) {
+	for(size_t i = 0; i < p->nruns; i++)
+		if(e->runs[i].error)
+			p->ret = 1;
+	e->done = true;
+	for(; p->printed < p->nentries && p->entries[p->printed].done; p->printed++)
+		print_entry(p,p->entries + p->printed);
+	fflush(stdout);
+}
+
+static void* run_worker(void* arg) {
+	struct profile* p = arg;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&p->lock);
+#endif
+	while(p->next < p->nentries && !p->ret) {
+		struct entry* e = p->entries + p->next++;
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&p->lock);
+#endif
+		profile_entry(p,e);
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&p->lock);
+#endif
+		finish_entry(p,e);
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&p->lock);
+#endif
+	return NULL;
+}
+
+// The calling thread is one of the workers. Returns the number that ran.
+static unsigned run_workers(struct profile* p, unsigned threads) {
+	unsigned nstarted = 0;
+#ifdef HAVE_PTHREAD
+	int err;
+	if((err = pthread_mutex_init(&p->lock,NULL))) {
+		fprintf(stderr,"Error initializing lock: %s\n",strerror(err));
+		p->ret = 1;
+		return 0;
+	}
+	// -j is only bounded by the dictionary, so the thread ids go on the heap
+	threads = MIN(threads,MAX(p->nentries,1));
+	pthread_t* tids = threads > 1 ? malloc(sizeof(*tids)*(threads-1)) : NULL;
+	if(tids)
+		for(; nstarted < threads-1; nstarted++)
+			if(pthread_create(tids+nstarted,NULL,run_worker,p))
+				break;
+#endif
+	run_worker(p);
+#ifdef HAVE_PTHREAD
+	for(unsigned i = 0; i < nstarted; i++)
+		pthread_join(tids[i],NULL);
+	free(tids);
+	pthread_mutex_destroy(&p->lock);
+#endif
+	return nstarted + 1;
+}
+
+static size_t bucket_index(size_t width, size_t height) {
+	size_t i = 0;
+	while(width*height > buckets[i].max_pixels)
+		i++;
+	return i;
+}
+
+static int cmp_ns(const void* left, const void* right) {
+	uint64_t l = *(const uint64_t*)left, r = *(const uint64_t*)right;
+	return l < r ? -1 : l > r;
+}
+
+// Nearest rank percentile of a sorted list
+static uint64_t percentile(const uint64_t* samples, size_t n, unsigned pct) {
+	size_t rank = (n * pct + 99) / 100;
+	return samples[rank ? rank-1 : 0];
+}
+
+struct totals {
+	uint64_t cpu_ns, wall_ns;
+	size_t peak_heap;
+	size_t plus, minus, known;
+	uint64_t* wall[NBUCKETS];
+	size_t nwall[NBUCKETS];
+};
+
+static bool sum_totals(const struct profile* p, struct totals* totals) {
+	for(size_t i = 0; i < p->nruns; i++) {
+		struct totals* t = totals + i;
+		for(size_t b = 0; b < NBUCKETS; b++)
+			if(!(t->wall[b] = malloc(sizeof(*t->wall[b])*MAX(p->nentries,1))))
+				return false;
+
+		for(size_t j = 0; j < p->nentries; j++) {
+			const struct entry* e = p->entries + j;
+			const struct run* run = e->runs + i;
+			if(e->error || run->error)
+				continue;
+			t->cpu_ns += run->cpu_ns;
+			t->wall_ns += run->wall_ns;
+			t->peak_heap = MAX(t->peak_heap,run->peak_heap);
+			t->plus += run->plus;
+			t->minus += run->minus;
+			t->known += run->known;
+			size_t b = bucket_index(e->width,e->height);
+			t->wall[b][t->nwall[b]++] = run->wall_ns;
+		}
+		for(size_t b = 0; b < NBUCKETS; b++)
+			qsort(t->wall[b],t->nwall[b],sizeof(*t->wall[b]),cmp_ns);
+	}
+	return true;
+}
+
+static void print_text_totals(const struct profile* p, const struct totals* totals) {
+	puts("totals");
+	for(size_t i = 0; i < p->nruns; i++) {
+		if(run_skipped(p,i))
+			continue;
+		const struct totals* t = totals + i;
+		size_t found = t->known - t->minus;
+		print_text_run(p,i,t->cpu_ns,t->wall_ns,t->peak_heap,t->plus,t->minus);
+		printf("   precision %5.1f%%   recall %5.1f%%\n",
+		       found+t->plus ? found*100.0/(found+t->plus) : 100,t->known ? found*100.0/t->known : 100);
+	}
+
+	puts("wall time percentiles");
+	for(size_t b = 0; b < NBUCKETS; b++)
+		for(size_t i = 0; i < p->nruns; i++) {
+			const struct totals* t = totals + i;
+			if(run_skipped(p,i) || !t->nwall[b])
+				continue;
+			const char* name = p->methods[i / p->nvariants].name;
+			printf("%-8s %s%-*s   %4zu images",buckets[b].name,name,p->padding-(int)strlen(name),p->suffixes[i % p->nvariants],t->nwall[b]);
+			for(size_t k = 0; k < NPERCENTILES; k++) {
+				uint64_t ns = percentile(t->wall[b],t->nwall[b],percentiles[k]);
+				printf("   p%u %2llu.%09llu",percentiles[k],(unsigned long long)(ns/1000000000),(unsigned long long)(ns%1000000000));
+			}
+			putchar('\n');
+		}
+}
+
+static void print_json_method(const struct profile* p, size_t i) {
+	char name[256];
+	snprintf(name,sizeof(name),"%s%s",p->methods[i / p->nvariants].name,p->suffixes[i % p->nvariants]);
+	print_json_string(name);
+}
+
+static void print_json(const struct profile* p, const struct totals* totals, unsigned threads) {
+	struct rusage rusage;
+	getrusage(RUSAGE_SELF,&rusage);
+	printf("{\"threads\":%u,\"max_rss_kib\":%ld,\"images\":[",threads,rusage.ru_maxrss);
+	for(size_t j = 0; j < p->nentries; j++) {
+		const struct entry* e = p->entries + j;
+		printf("%s{\"file\":",j ? "," : "");
+		print_json_string(e->filename);
+		if(e->error) {
+			fputs(",\"error\":",stdout);
+			print_json_string(resdet_error_str(e->error));
+			putchar('}');
+			continue;
+		}
+		printf(",\"width\":%zu,\"height\":%zu,\"frames\":%zu,\"bucket\":\"%s\",\"runs\":[",
+		       e->width,e->height,e->frames,buckets[bucket_index(e->width,e->height)].name);
+		bool first = true;
+		for(size_t i = 0; i < p->nruns; i++) {
+			const struct run* run = e->runs + i;
+			if(run_skipped(p,i))
+				continue;
+			printf("%s{\"method\":",first ? "" : ",");
+			first = false;
+			print_json_method(p,i);
+			if(run->error) {
+				fputs(",\"error\":",stdout);
+				print_json_string(resdet_error_str(run->error));
+			}
+			else
+				printf(",\"cpu_seconds\":%.9f,\"wall_seconds\":%.9f,\"peak_heap\":%zu,\"extra\":%zu,\"missed\":%zu",
+				       run->cpu_ns/1e9,run->wall_ns/1e9,run->peak_heap,run->plus,run->minus);
+			putchar('}');
+		}
+		fputs("]}",stdout);
+	}
+
+	fputs("],\"methods\":[",stdout);
+	bool first_method = true;
+	for(size_t i = 0; i < p->nruns; i++) {
+		if(run_skipped(p,i))
+			continue;
+		const struct totals* t = totals + i;
+		size_t found = t->known - t->minus;
+		printf("%s{\"method\":",first_method ? "" : ",");
+		first_method = false;
+		print_json_method(p,i);
+		printf(",\"cpu_seconds\":%.9f,\"wall_seconds\":%.9f,\"peak_heap\":%zu,\"extra\":%zu,\"missed\":%zu,\"precision\":",
+		       t->cpu_ns/1e9,t->wall_ns/1e9,t->peak_heap,t->plus,t->minus);
+		print_ratio(found,found+t->plus);
+		fputs(",\"recall\":",stdout);
+		print_ratio(found,t->known);
+		fputs(",\"buckets\":[",stdout);
+		bool first = true;
+		for(size_t b = 0; b < NBUCKETS; b++) {
+			if(!t->nwall[b])
+				continue;
+			printf("%s{\"bucket\":\"%s\",\"images\":%zu",first ? "" : ",",buckets[b].name,t->nwall[b]);
+			for(size_t k = 0; k < NPERCENTILES; k++)
+				printf(",\"p%u_wall_seconds\":%.9f",percentiles[k],percentile(t->wall[b],t->nwall[b],percentiles[k])/1e9);
+			putchar('}');
+			first = false;
+		}
+		fputs("]}",stdout);
+	}
+	puts("]}");
+}
+
 int main(int argc, char* argv[]) {
-	if(argc < 2) {
+	bool compare_bf16 = false, json = false;
+	float coarse_fraction = 0;
+	unsigned threads = 1;
+	int opt;
+	while((opt = getopt(argc,argv,"bc:j:J")) != -1)
+		switch(opt) {
+			case 'b': compare_bf16 = true; break;
+			case 'c': {
+				char* endptr;
+				coarse_fraction = strtof(optarg,&endptr);
+				if(endptr == optarg || !(coarse_fraction > 0 && coarse_fraction <= 1)) {
+					fprintf(stderr,"Invalid coarse fraction %s\n",optarg);
+					return 1;
+				}
+			} break;
+			case 'j': {
+				char* endptr;
+				threads = strtoul(optarg,&endptr,10);
+				if(endptr == optarg || *endptr || !threads) {
+					fprintf(stderr,"Invalid thread count %s\n",optarg);
+					return 1;
+				}
+#ifndef HAVE_PTHREAD
+				if(threads > 1) {
+					fprintf(stderr,"Built without thread support\n");
+					return 1;
+				}
+#endif
+			} break;
+			case 'J': json = true; break;
+			default: return 1;
+		}
+
+	if(optind >= argc) {
 		fprintf(stderr,
-"Usage: %s dict.txt\n"
+"Usage: %s [-b] [-c fraction] [-j threads] [-J] dict.txt\n"
+"\n"
+"-b also runs the methods with bfloat16 kernels (sign and mag) on bfloat16 coefficients, listed as method/bf16\n"
+"-c also runs each method in coarse mode over the given fraction of rows and columns, listed as method/coarse\n"
+"-j profiles this many images at once (default 1). CPU time and peak heap are still per image and method\n"
+"-J prints results as a single JSON object\n"
+"\n"
+"Each method's CPU time, wall time, peak libresdet heap and extra and missed resolutions are listed per image,\n"
+"followed by totals with precision and recall, and wall time percentiles by image size.\n"
 "\n"
 "dict.txt provides a set of images with known resolutions with the format\n"
 "\tfilename\n"
@@ -87,6 +589,34 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 
+	resdet_set_allocator(&(RDAllocator){ .malloc_fn = counting_malloc, .free_fn = counting_free });
+
+	int ret = 0;
+	// variant 0 runs with default parameters, the rest with each requested mode
+	RDParameters* variants[3] = { NULL };
+	const char* suffixes[3] = { "" };
+	size_t nvariants = 1, bf16_variant = 0;
+	int suffixlen = 0;
+	if(compare_bf16 || coarse_fraction) {
+		for(size_t i = 1; i < 3; i++)
+			if(!(variants[i] = resdet_alloc_default_parameters())) {
+				fprintf(stderr,"%s\n",resdet_error_str(RDENOMEM));
+				free(variants[1]);
+				return 1;
+			}
+	}
+	if(compare_bf16) {
+		variants[nvariants]->bf16_coeffs = true;
+		bf16_variant = nvariants;
+		suffixes[nvariants++] = "/bf16";
+	}
+	if(coarse_fraction) {
+		resdet_parameters_set_coarse_fraction(variants[nvariants],coarse_fraction);
+		suffixes[nvariants++] = "/coarse";
+	}
+	for(size_t i = 1; i < nvariants; i++)
+		suffixlen = MAX(suffixlen,strlen(suffixes[i]));
+
 	RDMethod* methods = resdet_methods();
 	size_t nmethods = 0;
 	int padding = 0;
@@ -95,106 +625,61 @@ int main(int argc, char* argv[]) {
 		if(strlen(m->name) > padding)
 			padding = strlen(m->name);
 	}
-	struct timeval tvs[nmethods];
-	memset(tvs,0,sizeof(tvs));
-	size_t diffplus[nmethods];
-	memset(diffplus,0,sizeof(diffplus));
-	size_t diffminus[nmethods];
-	memset(diffminus,0,sizeof(diffminus));
+	padding = MAX(padding+suffixlen,(int)strlen("method"));
 
-	FILE* dict = fopen(argv[1],"r");
+	struct profile p = {
+		.methods = methods,
+		.variants = variants,
+		.suffixes = suffixes,
+		.nvariants = nvariants,
+		.nruns = nmethods * nvariants,
+		.bf16_variant = bf16_variant,
+		.padding = padding,
+		.json = json
+	};
+	struct totals* totals = NULL;
+
+	FILE* dict = fopen(argv[optind],"r");
 	if(!dict) {
 		fprintf(stderr,"Error opening dictionary file: %s\n",strerror(errno));
-		return 1;
+		ret = 1;
+		goto variants_end;
+	}
+	bool read = read_dict(dict,p.nruns,&p.entries,&p.nentries);
+	fclose(dict);
+	if(!read) {
+		fprintf(stderr,"Invalid dictionary file\n");
+		ret = 1;
+		goto end;
 	}
-	int ret = 0;
-	ssize_t len;
-	size_t len2;
-	char* line = NULL;
-	while(!ret && (len = getline(&line,&len2,dict)) > 0) {
-		if(*line == '\n')
-			continue;
-		line[len-1] = '\0';
-		puts(line);
-		float* image;
-		size_t w, h, d;
-		RDError e = resdet_read_image(line,NULL,&image,&d,&w,&h);
-		if(e) {
-			fprintf(stderr, "Error reading %s: %s\n",line,resdet_error_str(e));
-			// skip over this image's resolution lists
-			if(getline(&line,&len2,dict) <= 0 ||
-			   getline(&line,&len2,dict) <= 0) {
-				ret = 1;
-				break;
-			}
-			continue;
-		}
-
-		size_t* knownw = NULL,* knownh  = NULL;
-		size_t knownwct, knownhct;
-		if((len = getline(&line,&len2,dict)) <= 0) {
-			ret = 1;
-			goto read_end;
-		}
-		line[len-1] = '\0';
 
-		readres(line,&knownw,&knownwct);
-		if(!knownwct) {
-			ret = 1;
-			goto read_end;
-		}
+	if(!json)
+		printf("%-*s   %12s   %12s   %12s   (+extra -missed)\n",padding,"method","cpu","wall","peak heap");
 
-		if((len = getline(&line,&len2,dict)) <= 0) {
-			ret = 1;
-			goto read_end;
-		}
-		line[len-1] = '\0';
+	threads = run_workers(&p,threads);
 
-		readres(line,&knownh,&knownhct);
-		if(!knownhct) {
-			ret = 1;
-			goto read_end;
-		}
+	if((ret = p.ret))
+		goto end;
 
-		for(RDMethod* m = methods; m->name; m++) {
-			RDResolution* rw = NULL,* rh = NULL;
-			size_t cw = 0, ch = 0;
-			struct rusage rusage;
-			getrusage(RUSAGE_SELF,&rusage);
-			struct timeval before = rusage.ru_utime;
-			if((e = resdetect(image,d,w,h,&rw,&cw,&rh,&ch,m,NULL))) {
-				fprintf(stderr, "Error during detection: %s\n",resdet_error_str(e));
-				ret = 1;
-				goto detect_end;
-			}
-			getrusage(RUSAGE_SELF,&rusage);
-			struct timeval after = rusage.ru_utime;
-
-			after = diffts(before,after);
-			tvs[m-methods].tv_sec += after.tv_sec + (tvs[m-methods].tv_usec + after.tv_usec) / 1000000;
-			tvs[m-methods].tv_usec = (tvs[m-methods].tv_usec + after.tv_usec) % 1000000;
-
-			size_t plus = 0, minus = 0;
-			diffres(knownw,knownwct,rw,cw-1,&plus,&minus);
-			diffres(knownh,knownhct,rh,ch-1,&plus,&minus);
-			diffplus[m-methods] += plus;
-			diffminus[m-methods] += minus;
-
-			printf("%-*s   %2ld.%.9ld   (+%zu -%zu)\n",padding,m->name,after.tv_sec,(long)after.tv_usec,plus,minus);
-detect_end:
-			free(rw);
-			free(rh);
-		}
-read_end:
-		free(knownw);
-		free(knownh);
-		free(image);
+	if(!(totals = calloc(p.nruns,sizeof(*totals))) || !sum_totals(&p,totals)) {
+		fprintf(stderr,"%s\n",resdet_error_str(RDENOMEM));
+		ret = 1;
+		goto end;
 	}
-	free(line);
-	fclose(dict);
+	if(json)
+		print_json(&p,totals,threads);
+	else
+		print_text_totals(&p,totals);
 
-	puts("totals");
-	for(RDMethod* m = methods; m->name; m++)
-		printf("%-*s   %2ld.%.9ld   (+%zu -%zu)\n",padding,m->name,tvs[m-methods].tv_sec,(long)tvs[m-methods].tv_usec,diffplus[m-methods],diffminus[m-methods]);
+end:
+	if(totals)
+		for(size_t i = 0; i < p.nruns; i++)
+			for(size_t b = 0; b < NBUCKETS; b++)
+				free(totals[i].wall[b]);
+	free(totals);
+	free_entries(p.entries,p.nentries);
+variants_end:
+	for(size_t i = 1; i < 3; i++)
+		free(variants[i]);
 	return ret;
 }
@@ -8,6 +8,16 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "resdet.h"
 
@@ -23,13 +33,793 @@ void seek_progress(void* ctx, uint64_t offset) {
 	fprintf(stderr,"Seeking past frame %" PRIu64 "\r",offset);
 }
 
+void print_results(int verbosity, RDResolution* rw, size_t cw, RDResolution* rh, size_t ch) {
+	if(!verbosity)
+		return;
+
+	if(verbosity == 1) {
+		printf("%zu %zu\n",rw[0].index,rh[0].index);
+		return;
+	}
+	if(verbosity == 2 || verbosity == 3) {
+		for(size_t i = 0; i < cw; i++) {
+			printf("%zu",rw[i].index);
+			if(verbosity == 3)
+				printf(":%f",rw[i].confidence);
+			putchar(' ');
+		}
+		putchar('\n');
+		for(size_t i = 0; i < ch; i++) {
+			printf("%zu",rh[i].index);
+			if(verbosity == 3)
+				printf(":%f",rh[i].confidence);
+			putchar(' ');
+		}
+		putchar('\n');
+		return;
+	}
+
+	printf("given: %zux%zu\nbest guess: %zux%zu%s\n",rw[cw-1].index,rh[ch-1].index,rw[0].index,rh[0].index, (cw==1 && ch==1 ? " (not upsampled)" : ""));
+	cw--; ch--;
+	if(MAX(cw,ch))
+		puts("all width        height");
+	for(size_t i = 0; i < MAX(cw,ch); i++) {
+		if(i < cw)
+			printf("%5zu (%5.2f%%)   ",rw[i].index,rw[i].confidence*100);
+		else printf("%17s","");
+		if(i < ch)
+			printf("%5zu (%5.2f%%)",rh[i].index,rh[i].confidence*100);
+		putchar('\n');
+	}
+}
+
+enum output_format {
+	OUTPUT_TEXT,
+	OUTPUT_JSON,
+	OUTPUT_CSV
+};
+
+double now(void) {
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC,&ts))
+		return 0;
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void print_json_string(FILE* out, const char* str) {
+	fputc('"',out);
+	for(; *str; str++) {
+		unsigned char c = *str;
+		if(c == '"' || c == '\\')
+			fprintf(out,"\\%c",c);
+		else if(c < 0x20)
+			fprintf(out,"\\u%04x",c);
+		else fputc(c,out);
+	}
+	fputc('"',out);
+}
+
+void print_csv_string(const char* str) {
+	if(!strpbrk(str,",\"\r\n")) {
+		fputs(str,stdout);
+		return;
+	}
+	putchar('"');
+	for(; *str; str++) {
+		if(*str == '"')
+			putchar('"');
+		putchar(*str);
+	}
+	putchar('"');
+}
+
+// Candidates exclude the last element, which is the input dimension.
+void print_json_candidates(FILE* out, const RDResolution* res, size_t count) {
+	fputc('[',out);
+	for(size_t i = 0; i + 1 < count; i++)
+		fprintf(out,"%s{\"size\":%zu,\"confidence\":%f}",i ? "," : "",res[i].index,res[i].confidence);
+	fputc(']',out);
+}
+
+void print_csv_candidates(const RDResolution* res, size_t count) {
+	for(size_t i = 0; i + 1 < count; i++)
+		printf("%s%zu:%f",i ? " " : "",res[i].index,res[i].confidence);
+}
+
+void print_csv_header(void) {
+	puts("file,width,height,frames,seconds,widths,heights,error");
+}
+
+// id is a raw JSON value echoed back to the client in serve mode, filename may be NULL for requests without one.
+void print_json_error(FILE* out, const char* id, const char* filename, const char* message) {
+	fputc('{',out);
+	if(id)
+		fprintf(out,"\"id\":%s,",id);
+	if(filename) {
+		fputs("\"file\":",out);
+		print_json_string(out,filename);
+		fputc(',',out);
+	}
+	fputs("\"error\":",out);
+	print_json_string(out,message);
+	fputs("}\n",out);
+}
+
+void print_json_record(FILE* out, const char* id, const RDFileResult* result) {
+	if(result->error) {
+		print_json_error(out,id,result->filename,resdet_error_str(result->error));
+		return;
+	}
+	fputc('{',out);
+	if(id)
+		fprintf(out,"\"id\":%s,",id);
+	if(result->filename) {
+		fputs("\"file\":",out);
+		print_json_string(out,result->filename);
+		fputc(',',out);
+	}
+	fprintf(out,"\"width\":%zu,\"height\":%zu,\"frames\":%" PRIu64 ",\"seconds\":%f,\"widths\":",
+	        result->width,result->height,result->nframes,result->seconds);
+	print_json_candidates(out,result->rw,result->cw);
+	fputs(",\"heights\":",out);
+	print_json_candidates(out,result->rh,result->ch);
+	fputs("}\n",out);
+}
+
+// Prints one JSON Lines or CSV record for a file, whether it succeeded or not.
+void print_record(enum output_format format, const RDFileResult* result) {
+	if(format == OUTPUT_JSON) {
+		print_json_record(stdout,NULL,result);
+		return;
+	}
+
+	print_csv_string(result->filename);
+	if(result->error) {
+		fputs(",,,,,,,",stdout);
+		print_csv_string(resdet_error_str(result->error));
+		putchar('\n');
+		return;
+	}
+	printf(",%zu,%zu,%" PRIu64 ",%f,",result->width,result->height,result->nframes,result->seconds);
+	print_csv_candidates(result->rw,result->cw);
+	putchar(',');
+	print_csv_candidates(result->rh,result->ch);
+	puts(",");
+}
+
+void add_stats(RDStats* total, const RDStats* stats) {
+	for(int i = 0; i < RDSTAGE_COUNT; i++) {
+		total->stages[i].ns += stats->stages[i].ns;
+		total->stages[i].count += stats->stages[i].count;
+	}
+}
+
+void print_stats(const RDStats* stats) {
+	fflush(stdout);
+	fprintf(stderr,"%-17s %10s %12s %12s\n","stage","count","total ms","mean us");
+	for(int i = 0; i < RDSTAGE_COUNT; i++) {
+		uint64_t ns = stats->stages[i].ns, count = stats->stages[i].count;
+		fprintf(stderr,"%-17s %10" PRIu64 " %12.3f %12.3f\n",resdet_stage_name(i),count,ns/1e6,count ? ns/1e3/count : 0);
+	}
+}
+
+struct batch_output {
+	int verbosity;
+	enum output_format format;
+	bool failed, not_upscaled;
+	RDStats stats;
+};
+
+void print_file_result(void* ctx, const RDFileResult* result) {
+	struct batch_output* out = ctx;
+	add_stats(&out->stats,&result->stats);
+	if(out->format) {
+		print_record(out->format,result);
+		fflush(stdout);
+	}
+	if(result->error) {
+		fprintf(stderr,"%s: %s\n",result->filename,resdet_error_str(result->error));
+		out->failed = true;
+		return;
+	}
+	if(result->cw == 1 && result->ch == 1)
+		out->not_upscaled = true;
+	if(out->verbosity && !out->format) {
+		puts(result->filename);
+		print_results(out->verbosity,result->rw,result->cw,result->rh,result->ch);
+		if(out->verbosity < 0)
+			putchar('\n');
+		fflush(stdout);
+	}
+}
+
+// Detects all inputs in parallel, returning the exit status.
+int detect_batch(const char** inputs, size_t ninputs, const char* type, RDMethod* m, RDParameters* params, unsigned threads, int verbosity, enum output_format format, bool stats) {
+	struct batch_output out = { .verbosity = verbosity, .format = format };
+	RDError e = resdetect_files(inputs,ninputs,type,m,params,threads,print_file_result,&out);
+	if(stats)
+		print_stats(&out.stats);
+	if(e) {
+		fprintf(stderr,"%s\n",resdet_error_str(e));
+		return 1;
+	}
+	if(out.failed)
+		return 1;
+	return !verbosity && !format && out.not_upscaled;
+}
+
+// Appends each line of a list file to inputs.
+bool read_list(const char* list, const char*** inputs, size_t* ninputs) {
+	FILE* f = strcmp(list,"-") ? fopen(list,"r") : stdin;
+	if(!f) {
+		fprintf(stderr,"Error opening list %s: %s\n",list,strerror(errno));
+		return false;
+	}
+
+	bool ret = true;
+	char* line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	while((len = getline(&line,&size,f)) > 0) {
+		if(line[len-1] == '\n')
+			line[--len] = '\0';
+		if(!len)
+			continue;
+		const char** tmp = realloc(*inputs,sizeof(**inputs)*(*ninputs+1));
+		char* path = strdup(line);
+		if(!(tmp && path)) {
+			if(tmp)
+				*inputs = tmp;
+			free(path);
+			fputs("Out of memory\n",stderr);
+			ret = false;
+			break;
+		}
+		*inputs = tmp;
+		(*inputs)[(*ninputs)++] = path;
+	}
+
+	free(line);
+	if(f != stdin)
+		fclose(f);
+	return ret;
+}
+
+// Serve mode: newline delimited JSON requests answered by a pool of workers, each keeping its last analysis warm.
+
+struct request {
+	char* id,* path,* type,* method,* pixels,* data;
+	size_t width, height, range;
+	uint64_t nframes;
+	float threshold;
+	uint8_t filter;
+};
+
+struct serve_defaults {
+	RDMethod* method;
+	const char* type;
+	size_t range;
+	float threshold;
+	uint8_t filter;
+};
+
+void free_request(struct request* r) {
+	free(r->id);
+	free(r->path);
+	free(r->type);
+	free(r->method);
+	free(r->pixels);
+	free(r->data);
+}
+
+const char* skip_space(const char* s) {
+	while(*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+		s++;
+	return s;
+}
+
+int parse_hex4(const char* s) {
+	int c = 0;
+	for(int i = 0; i < 4; i++) {
+		int d;
+		if(s[i] >= '0' && s[i] <= '9') d = s[i] - '0';
+		else if(s[i] >= 'a' && s[i] <= 'f') d = s[i] - 'a' + 10;
+		else if(s[i] >= 'A' && s[i] <= 'F') d = s[i] - 'A' + 10;
+		else return -1;
+		c = c << 4 | d;
+	}
+	return c;
+}
+
+size_t put_utf8(char* out, unsigned long c) {
+	if(c < 0x80) {
+		out[0] = c;
+		return 1;
+	}
+	if(c < 0x800) {
+		out[0] = 0xC0 | c >> 6;
+		out[1] = 0x80 | (c & 0x3F);
+		return 2;
+	}
+	if(c < 0x10000) {
+		out[0] = 0xE0 | c >> 12;
+		out[1] = 0x80 | (c >> 6 & 0x3F);
+		out[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+	out[0] = 0xF0 | c >> 18;
+	out[1] = 0x80 | (c >> 12 & 0x3F);
+	out[2] = 0x80 | (c >> 6 & 0x3F);
+	out[3] = 0x80 | (c & 0x3F);
+	return 4;
+}
+
+// Decodes the JSON string starting at s, returning the position following it or NULL if invalid.
+const char* parse_json_string(const char* s, char** str) {
+	if(*s++ != '"')
+		return NULL;
+	// escapes never decode to more bytes than they take up
+	char* out = malloc(strlen(s)+1);
+	if(!out)
+		return NULL;
+	size_t n = 0;
+	for(; *s != '"'; s++) {
+		if(!*s || (unsigned char)*s < 0x20)
+			goto error;
+		if(*s != '\\') {
+			out[n++] = *s;
+			continue;
+		}
+		switch(*++s) {
+			case '"': case '\\': case '/': out[n++] = *s; break;
+			case 'b': out[n++] = '\b'; break;
+			case 'f': out[n++] = '\f'; break;
+			case 'n': out[n++] = '\n'; break;
+			case 'r': out[n++] = '\r'; break;
+			case 't': out[n++] = '\t'; break;
+			case 'u': {
+				long c = parse_hex4(s+1);
+				if(c <= 0)
+					goto error;
+				s += 4;
+				if(c >= 0xD800 && c < 0xDC00 && s[1] == '\\' && s[2] == 'u') {
+					long lo = parse_hex4(s+3);
+					if(lo >= 0xDC00 && lo < 0xE000) {
+						c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+						s += 6;
+					}
+				}
+				n += put_utf8(out+n,c);
+			} break;
+			default: goto error;
+		}
+	}
+	out[n] = '\0';
+	*str = out;
+	return s+1;
+
+error:
+	free(out);
+	return NULL;
+}
+
+// Parses a flat JSON object into r. Unknown keys are ignored, nested values aren't supported.
+bool parse_request(const char* line, struct request* r) {
+	const char* s = skip_space(line);
+	if(*s++ != '{')
+		return false;
+	s = skip_space(s);
+	if(*s == '}')
+		return !*skip_space(s+1);
+
+	for(;;) {
+		char* key,* str = NULL;
+		double num = 0;
+		if(!(s = parse_json_string(s,&key)))
+			return false;
+		s = skip_space(s);
+		if(*s++ != ':') {
+			free(key);
+			return false;
+		}
+		const char* value = s = skip_space(s);
+		char* end;
+		if(*s == '"')
+			end = (char*)parse_json_string(s,&str);
+		else if(!strncmp(s,"true",4) || !strncmp(s,"null",4))
+			end = (char*)s+4;
+		else if(!strncmp(s,"false",5))
+			end = (char*)s+5;
+		else {
+			num = strtod(s,&end);
+			if(end == s)
+				end = NULL;
+		}
+		if(!end) {
+			free(key);
+			return false;
+		}
+		s = end;
+
+		bool valid = true;
+		if(!strcmp(key,"id")) {
+			free(r->id);
+			valid = (r->id = strndup(value,s-value));
+		}
+		else if(!strcmp(key,"path") || !strcmp(key,"type") || !strcmp(key,"method") || !strcmp(key,"pixels") || !strcmp(key,"data")) {
+			char** field = key[0] == 'p' ? (key[1] == 'a' ? &r->path : &r->pixels) : key[0] == 't' ? &r->type : key[0] == 'd' ? &r->data : &r->method;
+			if((valid = str)) {
+				free(*field);
+				*field = str;
+				str = NULL;
+			}
+		}
+		else if(!strcmp(key,"threshold")) {
+			// a negative threshold only means "use the default" internally, so it's not accepted here
+			valid = !str && num >= 0 && *value != 't' && *value != 'f' && *value != 'n';
+			r->threshold = num/100;
+		}
+		else if(!strcmp(key,"width") || !strcmp(key,"height") || !strcmp(key,"range") || !strcmp(key,"frames") || !strcmp(key,"filter")) {
+			// checked against the destination's range first, since converting an out of range double is undefined
+			double limit = !strcmp(key,"frames") ? (double)UINT64_MAX : (double)SIZE_MAX;
+			valid = !str && num >= 0 && num < limit && num == (uint64_t)num && *value != 't' && *value != 'f' && *value != 'n';
+			switch(key[0]) {
+				case 'w': r->width = num; break;
+				case 'h': r->height = num; break;
+				case 'r': r->range = num; break;
+				case 'f':
+					if(key[1] == 'r')
+						r->nframes = num;
+					else if((valid = valid && num <= UINT8_MAX))
+						r->filter = num;
+					break;
+			}
+		}
+		free(key);
+		free(str);
+		if(!valid)
+			return false;
+
+		s = skip_space(s);
+		if(*s == '}')
+			return !*skip_space(s+1);
+		if(*s++ != ',')
+			return false;
+		s = skip_space(s);
+	}
+}
+
+// Decodes standard base64 in place, returning the decoded length or -1 if invalid.
+ssize_t decode_base64(char* str) {
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t n = 0, bits = 0;
+	uint32_t acc = 0;
+	const char* s = str;
+	for(; *s && *s != '='; s++) {
+		const char* pos = strchr(alphabet,*s);
+		if(!pos)
+			return -1;
+		acc = acc << 6 | (pos - alphabet);
+		if((bits += 6) >= 8) {
+			bits -= 8;
+			str[n++] = acc >> bits;
+		}
+	}
+	while(*s == '=')
+		s++;
+	return *s ? -1 : (ssize_t)n;
+}
+
+struct server {
+	FILE* in,* out;
+	int listener;
+	struct serve_defaults defaults;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t in_lock, out_lock;
+#endif
+};
+
+struct serve_worker {
+	struct server* server;
+	RDAnalysis* analysis;
+	RDMethod* method;
+	size_t width, height, range;
+	float threshold;
+	uint8_t filter;
+};
+
+// Reuses the worker's analysis when the request matches it, otherwise replaces it.
+RDAnalysis* request_analysis(struct serve_worker* w, RDMethod* m, const struct request* r, size_t width, size_t height, RDError* e) {
+	if(w->analysis && w->method == m && w->width == width && w->height == height &&
+	   w->range == r->range && w->threshold == r->threshold && w->filter == r->filter) {
+		resdet_reset_analysis(w->analysis);
+		return w->analysis;
+	}
+	resdet_destroy_analysis(w->analysis);
+	w->analysis = NULL;
+
+	RDParameters* params = resdet_alloc_default_parameters();
+	if(!params) {
+		*e = RDENOMEM;
+		return NULL;
+	}
+	if(resdet_parameters_set_range(params,r->range) ||
+	   (r->threshold >= 0 && resdet_parameters_set_threshold(params,r->threshold)) ||
+	   resdet_parameters_set_compression_filter(params,r->filter)) {
+		free(params);
+		*e = RDEPARAM;
+		return NULL;
+	}
+	w->analysis = resdet_create_analysis(m,width,height,params,e);
+	free(params);
+	if(w->analysis) {
+		w->method = m;
+		w->width = width;
+		w->height = height;
+		w->range = r->range;
+		w->threshold = r->threshold;
+		w->filter = r->filter;
+	}
+	return w->analysis;
+}
+
+void handle_request(struct serve_worker* w, const char* line, FILE* out) {
+	const struct serve_defaults* d = &w->server->defaults;
+	struct request r = { .range = d->range, .threshold = d->threshold, .filter = d->filter };
+	if(!parse_request(line,&r)) {
+		print_json_error(out,r.id,NULL,"Invalid request");
+		goto end;
+	}
+	if(!r.path + !r.pixels + !r.data != 2) {
+		print_json_error(out,r.id,NULL,"Requests need one of path, pixels or data");
+		goto end;
+	}
+
+	RDMethod* m = r.method ? resdet_get_method(r.method) : d->method;
+	if(!m) {
+		print_json_error(out,r.id,r.path,"Invalid method");
+		goto end;
+	}
+
+	RDFileResult result = { .filename = r.path };
+	double start = now();
+	float* image = NULL;
+	RDImage* rdimage = NULL;
+	RDAnalysis* analysis;
+
+	if(r.path || r.data) {
+		const char* type = r.type ? r.type : d->type;
+		if(r.path)
+			rdimage = resdet_open_image(r.path,type,&result.width,&result.height,&image,&result.error);
+		else {
+			// the image is read straight from the decoded bytes without going through a file
+			ssize_t len = decode_base64(r.data);
+			if(len <= 0 || !type) {
+				print_json_error(out,r.id,NULL,"Data must be a base64 encoded image file with a type");
+				goto end;
+			}
+			rdimage = resdet_open_image_mem(r.data,len,type,&result.width,&result.height,&image,&result.error);
+		}
+		if(result.error)
+			goto done;
+		if(!(analysis = request_analysis(w,m,&r,result.width,result.height,&result.error)))
+			goto done;
+		while((!r.nframes || result.nframes < r.nframes) && resdet_read_image_frame(rdimage,image,&result.error)) {
+			if((result.error = resdet_analyze_image(analysis,image)))
+				break;
+			result.nframes++;
+		}
+	}
+	else {
+		if(r.width && r.height && r.width > SIZE_MAX / sizeof(float) / r.height) {
+			print_json_error(out,r.id,NULL,"Pixel dimensions are too large");
+			goto end;
+		}
+		ssize_t len = decode_base64(r.pixels);
+		size_t frame = r.width * r.height * sizeof(float);
+		if(len <= 0 || !frame || len % frame) {
+			print_json_error(out,r.id,NULL,"Pixels must be base64 encoded floats of whole width by height frames");
+			goto end;
+		}
+		result.width = r.width;
+		result.height = r.height;
+		if(!(analysis = request_analysis(w,m,&r,result.width,result.height,&result.error)))
+			goto done;
+		// copy each frame out since the decoded string isn't aligned for floats
+		if(!(image = malloc(frame))) {
+			result.error = RDENOMEM;
+			goto done;
+		}
+		for(size_t i = 0; i < len / frame && (!r.nframes || result.nframes < r.nframes); i++) {
+			memcpy(image,r.pixels + i * frame,frame);
+			if((result.error = resdet_analyze_image(analysis,image)))
+				break;
+			result.nframes++;
+		}
+	}
+
+	if(!result.error && !result.nframes)
+		result.error = RDENOIMG;
+	if(!result.error)
+		result.error = resdet_analysis_results(analysis,&result.rw,&result.cw,&result.rh,&result.ch);
+
+done:
+	result.seconds = now() - start;
+	print_json_record(out,r.id,&result);
+	free(result.rw);
+	free(result.rh);
+	free(image);
+	resdet_close_image(rdimage);
+end:
+	free_request(&r);
+}
+
+// Answers each request line from in, taking turns with the other workers when the stream is shared.
+void serve_stream(struct serve_worker* w, FILE* in, FILE* out, bool shared) {
+	char* line = NULL,* response = NULL;
+	size_t size = 0, response_size;
+	FILE* buf = NULL;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t* in_lock = shared ? &w->server->in_lock : NULL,* out_lock = shared ? &w->server->out_lock : NULL;
+#endif
+	for(;;) {
+#ifdef HAVE_PTHREAD
+		if(in_lock)
+			pthread_mutex_lock(in_lock);
+#endif
+		ssize_t len = getline(&line,&size,in);
+#ifdef HAVE_PTHREAD
+		if(in_lock)
+			pthread_mutex_unlock(in_lock);
+#endif
+		if(len < 0)
+			break;
+		if(!*skip_space(line))
+			continue;
+
+		// buffer the response so responses from concurrent workers don't interleave
+		if(!(buf = open_memstream(&response,&response_size)))
+			break;
+		handle_request(w,line,buf);
+		fclose(buf);
+
+#ifdef HAVE_PTHREAD
+		if(out_lock)
+			pthread_mutex_lock(out_lock);
+#endif
+		fputs(response,out);
+		fflush(out);
+#ifdef HAVE_PTHREAD
+		if(out_lock)
+			pthread_mutex_unlock(out_lock);
+#endif
+		free(response);
+		response = NULL;
+	}
+	free(line);
+}
+
+void* run_serve_worker(void* arg) {
+	struct serve_worker* w = arg;
+	if(w->server->listener < 0) {
+		serve_stream(w,w->server->in,w->server->out,true);
+		return NULL;
+	}
+
+	for(;;) {
+		int conn = accept(w->server->listener,NULL,NULL);
+		if(conn < 0) {
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			perror("accept");
+			return NULL;
+		}
+		int outfd = dup(conn);
+		FILE* in = fdopen(conn,"r"),* out = outfd < 0 ? NULL : fdopen(outfd,"w");
+		if(in && out)
+			serve_stream(w,in,out,false);
+		if(in) fclose(in); else close(conn);
+		if(out) fclose(out); else if(outfd >= 0) close(outfd);
+	}
+}
+
+int open_listener(const char* path) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr,"Socket path too long: %s\n",path);
+		return -1;
+	}
+	strcpy(addr.sun_path,path);
+
+	// replace a socket left behind by a previous server, but nothing else
+	struct stat st;
+	if(!stat(path,&st) && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	int fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(fd < 0 || bind(fd,(struct sockaddr*)&addr,sizeof(addr)) || listen(fd,SOMAXCONN)) {
+		fprintf(stderr,"Error listening on %s: %s\n",path,strerror(errno));
+		if(fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Serves requests from stdin, or from connections to a Unix domain socket, until input ends.
+int serve(const char* address, unsigned threads, struct serve_defaults defaults) {
+	struct server s = { .in = stdin, .out = stdout, .listener = -1, .defaults = defaults };
+	if(strcmp(address,"-") && (s.listener = open_listener(address)) < 0)
+		return 1;
+	signal(SIGPIPE,SIG_IGN);
+
+#ifdef HAVE_PTHREAD
+	if(!threads) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = n > 0 ? n : 1;
+	}
+#else
+	threads = 1;
+#endif
+
+	struct serve_worker* workers = calloc(threads,sizeof(*workers));
+	if(!workers) {
+		fputs("Out of memory\n",stderr);
+		if(s.listener >= 0)
+			close(s.listener);
+		return 1;
+	}
+
+#ifdef HAVE_PTHREAD
+	int err = pthread_mutex_init(&s.in_lock,NULL);
+	if(!err && (err = pthread_mutex_init(&s.out_lock,NULL)))
+		pthread_mutex_destroy(&s.in_lock);
+	if(err) {
+		fprintf(stderr,"Error initializing server locks: %s\n",strerror(err));
+		free(workers);
+		if(s.listener >= 0)
+			close(s.listener);
+		return 1;
+	}
+#endif
+
+	for(unsigned i = 0; i < threads; i++)
+		workers[i].server = &s;
+
+#ifdef HAVE_PTHREAD
+	pthread_t* tids = malloc(sizeof(*tids)*threads);
+	unsigned nstarted = 0;
+	if(tids)
+		for(; nstarted < threads-1; nstarted++)
+			if(pthread_create(tids+nstarted,NULL,run_serve_worker,workers+nstarted+1))
+				break;
+#endif
+
+	run_serve_worker(workers);
+
+#ifdef HAVE_PTHREAD
+	for(unsigned i = 0; i < nstarted; i++)
+		pthread_join(tids[i],NULL);
+	free(tids);
+	pthread_mutex_destroy(&s.in_lock);
+	pthread_mutex_destroy(&s.out_lock);
+#endif
+
+	for(unsigned i = 0; i < threads; i++)
+		resdet_destroy_analysis(workers[i].analysis);
+	free(workers);
+	if(s.listener >= 0)
+		close(s.listener);
+	return 0;
+}
+
 void usage(const char* self) {
-	fprintf(stderr,"Usage: %s [-h -V -m <method> -v <verbosity> -t <filetype> -R <image_reader> -r <range> -x <threshold> -f <value> -p -o <offset> -n <nframes>] image\n",self);
+	fprintf(stderr,"Usage: %s [-h -V -m <method> -v <verbosity> -t <filetype> -R <image_reader> -r <range> -x <threshold> -f <value> -H -p -o <offset> -n <nframes> -l <list> -j <threads> -O <format> -S <socket> -s] image...\n",self);
 	exit(1);
 }
 
 void help(const char* self) {
-	printf("Usage: %s [-h -V -m <method> -v <verbosity> -t <filetype> -r <range> -x <threshold> -f <value> -p -o <offset> -n <nframes>] image\n"
+	printf("Usage: %s [-h -V -m <method> -v <verbosity> -t <filetype> -r <range> -x <threshold> -f <value> -H -p -o <offset> -n <nframes> -l <list> -j <threads> -O <format> -S <socket> -s] image...\n"
 		" -h   This help text.\n"
 		" -V   Show the resdet CLI and library version.\n"
 		"\n"
@@ -44,10 +834,29 @@ void help(const char* self) {
 		"                    Use -R list to see available image readers.\n"
 		" -r   range: Number of neighboring values to search (%zu).\n"
 		" -x   threshold: Print all detection results above this method-specific confidence level (0-100).\n"
-		" -f   Filter out possible compression artifacts. Value: an integer filter value or \"auto\" to set one based on the file type."
+		" -f   Filter out possible compression artifacts. Value: an integer filter value or \"auto\" to set one based on the file type.\n"
+		" -H   Back large analysis buffers with transparent huge pages where supported.\n"
 		" -p   Show progress in number of frames analyzed so far.\n"
 		" -o   offset: Seek to this frame number before starting detection.\n"
 		" -n   nframes: Limit detection to this number of frames.\n"
+		" -l   list: Also read images to detect from this file, one path per line. Use - for stdin.\n"
+		" -j   threads: Number of images to detect at once with multiple images, 0 for one per CPU (0).\n"
+		" -s   Print time spent in each stage of reading and detection to stderr when done.\n"
+		" -S   socket: Serve requests on this Unix domain socket, or - for stdin and stdout, instead of detecting images.\n"
+		" -O   format: Print a machine-readable record per image instead, overriding -v.\n"
+		"              json - JSON Lines with the file, dimensions, frame count, time taken, and detected widths and heights.\n"
+		"              csv  - The same as CSV with a header, candidates as space separated size:confidence pairs.\n"
+		"\n"
+		"With multiple images, each one's results are printed after its name as soon as it completes.\n"
+		"-R, -p, -o, -n and -f auto only apply to single images.\n"
+		"\n"
+		"In serve mode each line of input is a JSON object with one of:\n"
+		"  path   - The image to detect, optionally with a type.\n"
+		"  pixels - Base64 encoded native endian 32-bit float frames, with a width and height.\n"
+		"  data   - A base64 encoded image file, with a type unless -t is given.\n"
+		"and optionally an id to echo back, method, range, threshold (0-100), filter and frames.\n"
+		"-m, -t, -r, -x and -f set their defaults. Each response is a -O json record, written as its request completes.\n"
+		"Requests are answered by -j workers, each reusing its analysis for consecutive images of the same size and options.\n"
 		"\n",
 		self,
 		resdet_default_range()
@@ -63,11 +872,13 @@ int main(int argc, char* argv[]) {
 	int c;
 	int verbosity = -1;
 	const char* method = NULL,* type = NULL,* image_reader = NULL;
-	const char* range_opt = NULL,* threshold_opt = NULL,* filter_opt = NULL;
+	const char* range_opt = NULL,* threshold_opt = NULL,* filter_opt = NULL,* list = NULL,* address = NULL;
+	unsigned threads = 0;
+	enum output_format format = OUTPUT_TEXT;
 	uint64_t offset = 0, nframes = 0;
-	bool progress = false, found_reader = false;
+	bool progress = false, found_reader = false, huge_pages = false, stats = false;
 	char* endptr;
-	while((c = getopt(argc,argv,"v:m:t:x:r:pn:o:R:f:hV")) != -1) {
+	while((c = getopt(argc,argv,"v:m:t:x:r:pn:o:R:f:l:j:O:S:sHhV")) != -1) {
 		switch(c) {
 			case 'v': verbosity = strtol(optarg,NULL,10); break;
 			case 'm': method = optarg; break;
@@ -104,6 +915,28 @@ int main(int argc, char* argv[]) {
 					return 1;
 				}
 				break;
+			case 'l': list = optarg; break;
+			case 'j': {
+				unsigned long value = strtoul(optarg,&endptr,10);
+				if(optarg == endptr || value > UINT_MAX) {
+					fprintf(stderr,"Invalid threads %s\n",optarg);
+					return 1;
+				}
+				threads = value;
+			} break;
+			case 'O':
+				if(!strcasecmp(optarg,"json"))
+					format = OUTPUT_JSON;
+				else if(!strcasecmp(optarg,"csv"))
+					format = OUTPUT_CSV;
+				else {
+					fprintf(stderr,"Invalid format %s, use json or csv\n",optarg);
+					return 1;
+				}
+				break;
+			case 'S': address = optarg; break;
+			case 's': stats = true; break;
+			case 'H': huge_pages = true; break;
 			case 'p': progress = true; break;
 			case 'h': help(argv[0]); break;
 			case 'V':
@@ -116,8 +949,17 @@ int main(int argc, char* argv[]) {
 	}
 
 	const char* input = argv[optind];
-	if(!input)
+	if(address && (input || list || format || image_reader || progress || offset || nframes || (filter_opt && !strcmp(filter_opt,"auto")))) {
+		fputs("-S can't be used with images, -l, -O, -R, -p, -o, -n or -f auto\n",stderr);
+		return 1;
+	}
+	if(!input && !list && !address)
 		usage(argv[0]);
+	bool batch = list || optind+1 < argc;
+	if(batch && (image_reader || progress || offset || nframes || (filter_opt && !strcmp(filter_opt,"auto")))) {
+		fputs("-R, -p, -o, -n and -f auto can't be used with multiple images\n",stderr);
+		return 1;
+	}
 
 	RDMethod* m = resdet_get_method(method);
 	if(!m) {
@@ -132,6 +974,7 @@ int main(int argc, char* argv[]) {
 		fputs("Out of memory",stderr);
 		return 1;
 	}
+	struct serve_defaults defaults = { .method = m, .type = type, .range = resdet_default_range(), .threshold = -1 };
 
 	if(threshold_opt) {
 		float threshold = strtod(threshold_opt,&endptr)/100;
@@ -140,6 +983,7 @@ int main(int argc, char* argv[]) {
 			free(params);
 			return 1;
 		}
+		defaults.threshold = threshold;
 	}
 	if(range_opt) {
 		size_t range = strtoull(range_opt,&endptr,10);
@@ -148,6 +992,7 @@ int main(int argc, char* argv[]) {
 			free(params);
 			return 1;
 		}
+		defaults.range = range;
 	}
 	if(filter_opt && strcmp(filter_opt,"auto")) {
 		unsigned long value = strtoul(filter_opt,&endptr,10);
@@ -156,14 +1001,50 @@ int main(int argc, char* argv[]) {
 			free(params);
 			return 1;
 		}
+		defaults.filter = value;
 	}
+	if(stats)
+		resdet_parameters_set_stats(params,true);
+	if(huge_pages && resdet_parameters_set_huge_pages(params,true))
+		fputs("Huge pages are not supported in this build, ignoring -H\n",stderr);
 	if(type && image_reader) {
 		fputs("Type option (-t) cannot be used with an image reader (-R)",stderr);
 		return 1;
 	}
 
+	if(address) {
+		free(params);
+		return serve(address,threads,defaults);
+	}
+
+	if(format == OUTPUT_CSV)
+		print_csv_header();
+
+	if(batch) {
+		size_t ninputs = argc-optind;
+		const char** inputs = malloc(sizeof(*inputs)*ninputs);
+		if(!inputs) {
+			fputs("Out of memory\n",stderr);
+			free(params);
+			return 1;
+		}
+		memcpy(inputs,argv+optind,sizeof(*inputs)*ninputs);
+
+		int ret = 1;
+		if(!list || read_list(list,&inputs,&ninputs))
+			ret = detect_batch(inputs,ninputs,type,m,params,threads,verbosity,format,stats);
+
+		for(size_t i = argc-optind; i < ninputs; i++)
+			free((char*)inputs[i]);
+		free(inputs);
+		free(params);
+		return ret;
+	}
+
 	RDResolution* rw = NULL,* rh = NULL;
 	size_t cw, ch;
+	size_t ct = 1;
+	double start = now();
 
 	size_t width, height;
 	float* image;
@@ -177,6 +1058,8 @@ int main(int argc, char* argv[]) {
 		rdimage = resdet_open_image(input,type,&width,&height,&image,&e);
 	if(e)
 		goto end;
+	if(stats)
+		resdet_image_set_stats(rdimage,true);
 
 	if(offset) {
 		if(!resdet_seek_frame(rdimage,offset,progress ? seek_progress : NULL,NULL,&e)) {
@@ -208,7 +1091,6 @@ int main(int argc, char* argv[]) {
 	if(e)
 		goto end;
 
-	size_t ct = 1;
 	while(resdet_read_image_frame(rdimage,image,&e)) {
 		if(progress)
 			fprintf(stderr,"Analyzing frame %" PRIu64 "\r",ct+offset);
@@ -233,45 +1115,25 @@ int main(int argc, char* argv[]) {
 
 	e = resdet_analysis_results(analysis,&rw,&cw,&rh,&ch);
 
-	if(e || !verbosity)
-		goto end;
+	if(!e && !format)
+		print_results(verbosity,rw,cw,rh,ch);
 
-	if(verbosity == 1) {
-		printf("%zu %zu\n",rw[0].index,rh[0].index);
-		goto end;
-	}
-	if(verbosity == 2 || verbosity == 3) {
-		for(size_t i = 0; i < cw; i++) {
-			printf("%zu",rw[i].index);
-			if(verbosity == 3)
-				printf(":%f",rw[i].confidence);
-			putchar(' ');
-		}
-		putchar('\n');
-		for(size_t i = 0; i < ch; i++) {
-			printf("%zu",rh[i].index);
-			if(verbosity == 3)
-				printf(":%f",rh[i].confidence);
-			putchar(' ');
-		}
-		putchar('\n');
-		goto end;
+end:
+	if(format && (e || rw)) {
+		print_record(format,&(RDFileResult){
+			.filename = input, .error = e,
+			.width = width, .height = height, .nframes = ct-1,
+			.rw = rw, .cw = cw, .rh = rh, .ch = ch,
+			.seconds = now() - start
+		});
 	}
-
-	printf("given: %zux%zu\nbest guess: %zux%zu%s\n",rw[cw-1].index,rh[ch-1].index,rw[0].index,rh[0].index, (cw==1 && ch==1 ? " (not upsampled)" : ""));
-	cw--; ch--;
-	if(MAX(cw,ch))
-		puts("all width        height");
-	for(size_t i = 0; i < MAX(cw,ch); i++) {
-		if(i < cw)
-			printf("%5zu (%5.2f%%)   ",rw[i].index,rw[i].confidence*100);
-		else printf("%17s","");
-		if(i < ch)
-			printf("%5zu (%5.2f%%)",rh[i].index,rh[i].confidence*100);
-		putchar('\n');
+	if(stats && rdimage) {
+		RDStats total = {0};
+		resdet_image_stats(rdimage,&total);
+		if(analysis)
+			resdet_analysis_stats(analysis,&total);
+		print_stats(&total);
 	}
-
-end:
 	resdet_destroy_analysis(analysis);
 	resdet_close_image(rdimage);
 	free(image);
@@ -0,0 +1,359 @@
+/*
+ * synth - Generate upscaled test images with known source resolutions for profile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#define MAX_TAPS 6
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+
+enum pattern { NOISE, TEXTURE };
+enum format { PFM, Y4M };
+
+typedef float (*kernel_func)(float);
+
+struct kernel {
+	const char* name;
+	kernel_func func;
+	float support;
+};
+
+struct taps {
+	size_t start;
+	int n;
+	float w[MAX_TAPS];
+};
+
+static float nearest(float x) {
+	return x >= -0.5f && x < 0.5f;
+}
+
+static float bilinear(float x) {
+	x = fabsf(x);
+	return x < 1 ? 1-x : 0;
+}
+
+// Keys cubic with a = -0.5 (Catmull-Rom)
+static float bicubic(float x) {
+	x = fabsf(x);
+	if(x < 1)
+		return (1.5f*x - 2.5f)*x*x + 1;
+	if(x < 2)
+		return ((-0.5f*x + 2.5f)*x - 4)*x + 2;
+	return 0;
+}
+
+static float lanczos(float x) {
+	if(x == 0)
+		return 1;
+	if(fabsf(x) >= 3)
+		return 0;
+	float px = M_PI*x;
+	return 3*sinf(px)*sinf(px/3)/(px*px);
+}
+
+static const struct kernel kernels[] = {
+	{ "nearest", nearest, 0.5 },
+	{ "bilinear", bilinear, 1 },
+	{ "bicubic", bicubic, 2 },
+	{ "lanczos", lanczos, 3 },
+	{ NULL }
+};
+
+static uint32_t hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+// hash(0) is 0, so a seed's first frame is the same however many frames are generated.
+static float lattice(uint32_t seed, uint32_t frame, uint32_t x, uint32_t y) {
+	return hash(seed ^ hash(x ^ hash(y ^ hash(frame)))) / (float)UINT32_MAX;
+}
+
+static float smoothstep(float t) {
+	return t*t*(3-2*t);
+}
+
+// Value noise summed over octaves, giving smooth structure with detail down to single pixels.
+static float texture(uint32_t seed, uint32_t frame, size_t x, size_t y) {
+	float v = 0, amplitude = 0.5, total = 0;
+	for(unsigned octave = 0, cell = 64; cell; octave++, cell /= 4) {
+		float fx = (float)x / cell, fy = (float)y / cell;
+		uint32_t ix = fx, iy = fy;
+		float tx = smoothstep(fx-ix), ty = smoothstep(fy-iy);
+		uint32_t s = seed + octave;
+		float top = lattice(s,frame,ix,iy) + (lattice(s,frame,ix+1,iy) - lattice(s,frame,ix,iy))*tx;
+		float bottom = lattice(s,frame,ix,iy+1) + (lattice(s,frame,ix+1,iy+1) - lattice(s,frame,ix,iy+1))*tx;
+		v += (top + (bottom-top)*ty) * amplitude;
+		total += amplitude;
+		amplitude /= 2;
+	}
+	return v / total;
+}
+
+static void generate(float* image, size_t width, size_t height, enum pattern pattern, uint32_t seed, uint32_t frame) {
+	for(size_t y = 0; y < height; y++)
+		for(size_t x = 0; x < width; x++)
+			image[y*width+x] = pattern == NOISE ? lattice(seed,frame,x,y) : texture(seed,frame,x,y);
+}
+
+// Source taps for each output sample, with pixel centers aligned and edges clamped.
+static struct taps* make_taps(const struct kernel* k, size_t src, size_t dst) {
+	struct taps* taps = malloc(sizeof(*taps)*dst);
+	if(!taps)
+		return NULL;
+
+	float scale = (float)src / dst;
+	for(size_t i = 0; i < dst; i++) {
+		float center = (i+0.5f)*scale - 0.5f;
+		long first = ceilf(center - k->support), last = floorf(center + k->support);
+		// picked directly, since rounding in center can land a halfway sample just outside the box
+		if(k->func == nearest) {
+			long j = floorf(center + 0.5f);
+			taps[i] = (struct taps){ .start = j < 0 ? 0 : MIN(j,(long)src-1), .n = 1, .w = { 1 } };
+			continue;
+		}
+		float sum = 0;
+		taps[i].n = 0;
+		for(long j = first; j <= last && taps[i].n < MAX_TAPS; j++) {
+			float w = k->func(j - center);
+			long idx = j < 0 ? 0 : (j >= (long)src ? (long)src-1 : j);
+			if(!taps[i].n)
+				taps[i].start = idx;
+			// clamped taps fold into the edge pixel's weight
+			size_t t = idx - taps[i].start;
+			if(t >= (size_t)taps[i].n) {
+				taps[i].w[taps[i].n] = 0;
+				taps[i].n = t+1;
+			}
+			taps[i].w[t] += w;
+			sum += w;
+		}
+		for(int j = 0; j < taps[i].n; j++)
+			taps[i].w[j] /= sum;
+	}
+	return taps;
+}
+
+static bool upscale(const float* src, size_t srcw, size_t srch, float* dst, size_t dstw, size_t dsth, const struct kernel* k) {
+	struct taps* xtaps = make_taps(k,srcw,dstw),* ytaps = make_taps(k,srch,dsth);
+	float* rows = malloc(sizeof(*rows)*dstw*srch);
+	if(!(xtaps && ytaps && rows)) {
+		free(xtaps);
+		free(ytaps);
+		free(rows);
+		return false;
+	}
+
+	for(size_t y = 0; y < srch; y++)
+		for(size_t x = 0; x < dstw; x++) {
+			float v = 0;
+			for(int t = 0; t < xtaps[x].n; t++)
+				v += src[y*srcw+xtaps[x].start+t] * xtaps[x].w[t];
+			rows[y*dstw+x] = v;
+		}
+
+	for(size_t y = 0; y < dsth; y++)
+		for(size_t x = 0; x < dstw; x++) {
+			float v = 0;
+			for(int t = 0; t < ytaps[y].n; t++)
+				v += rows[(ytaps[y].start+t)*dstw+x] * ytaps[y].w[t];
+			dst[y*dstw+x] = v < 0 ? 0 : (v > 1 ? 1 : v);
+		}
+
+	free(xtaps);
+	free(ytaps);
+	free(rows);
+	return true;
+}
+
+static bool write_frame(FILE* out, enum format format, const float* image, size_t width, size_t height, size_t frame) {
+	if(format == PFM) {
+		// floats are written in host order, which the sign of the scale gives
+		fprintf(out,"Pf\n%zu %zu\n%s\n",width,height,(union { int i; char c; }){1}.c ? "-1.0" : "1.0");
+		for(size_t i = height; i > 0; i--)
+			fwrite(image+(i-1)*width,sizeof(*image),width,out);
+	}
+	else {
+		if(!frame)
+			fprintf(out,"YUV4MPEG2 W%zu H%zu F25:1 Ip A1:1 Cmono\n",width,height);
+		fputs("FRAME\n",out);
+		for(size_t i = 0; i < width*height; i++)
+			fputc(lrintf(image[i]*255),out);
+	}
+	return !ferror(out);
+}
+
+static bool parse_size(const char* s, size_t* width, size_t* height, char** end) {
+	*width = strtoull(s,end,10);
+	if(**end != 'x')
+		return false;
+	*height = strtoull(*end+1,end,10);
+	return *width && *height;
+}
+
+int main(int argc, char* argv[]) {
+	enum pattern pattern = NOISE;
+	enum format format = PFM;
+	unsigned long frames = 1, seed = 1;
+	const char* dictname = NULL;
+	bool use_kernel[sizeof(kernels)/sizeof(*kernels)] = { false };
+	bool kernels_given = false;
+
+	int opt;
+	while((opt = getopt(argc,argv,"k:p:f:n:s:d:")) != -1)
+		switch(opt) {
+			case 'k': {
+				kernels_given = true;
+				char* list = optarg,* name;
+				while((name = strsep(&list,","))) {
+					size_t i;
+					for(i = 0; kernels[i].name && strcmp(kernels[i].name,name); i++)
+						;
+					if(!kernels[i].name) {
+						fprintf(stderr,"Unknown kernel %s\n",name);
+						return 1;
+					}
+					use_kernel[i] = true;
+				}
+			} break;
+			case 'p':
+				if(!strcmp(optarg,"noise"))
+					pattern = NOISE;
+				else if(!strcmp(optarg,"texture"))
+					pattern = TEXTURE;
+				else {
+					fprintf(stderr,"Unknown pattern %s\n",optarg);
+					return 1;
+				}
+				break;
+			case 'f':
+				if(!strcmp(optarg,"pfm"))
+					format = PFM;
+				else if(!strcmp(optarg,"y4m"))
+					format = Y4M;
+				else {
+					fprintf(stderr,"Unknown format %s\n",optarg);
+					return 1;
+				}
+				break;
+			case 'n': frames = strtoul(optarg,NULL,10); break;
+			case 's': seed = strtoul(optarg,NULL,10); break;
+			case 'd': dictname = optarg; break;
+			default: return 1;
+		}
+
+	if(argc - optind < 2 || !frames) {
+		fprintf(stderr,
+"Usage: %s [-k kernel,...] [-p noise|texture] [-f pfm|y4m] [-n frames] [-s seed] [-d dict.txt] outdir WxH:WxH ...\n"
+"\n"
+"Generates an image at each source size and writes it upscaled to each target size, as in 640x360:1280x720.\n"
+"\n"
+"-k upscaling kernels, from nearest, bilinear, bicubic and lanczos (default all)\n"
+"-p source content, uniform noise or a smooth procedural texture (default noise)\n"
+"-f output format (default pfm)\n"
+"-n number of frames, each with different content (default 1)\n"
+"-s seed, the same seed always produces the same images (default 1)\n"
+"-d dictionary file for profile listing each image's source resolution (default outdir/dict.txt)\n"
+		,argv[0]);
+		return 1;
+	}
+
+	if(!kernels_given)
+		for(size_t i = 0; kernels[i].name; i++)
+			use_kernel[i] = true;
+
+	const char* outdir = argv[optind++];
+	char defaultdict[FILENAME_MAX];
+	if(!dictname) {
+		if(snprintf(defaultdict,sizeof(defaultdict),"%s/dict.txt",outdir) >= sizeof(defaultdict)) {
+			fprintf(stderr,"%s\n",strerror(ENAMETOOLONG));
+			return 1;
+		}
+		dictname = defaultdict;
+	}
+
+	int ret = 1;
+	FILE* dict = fopen(dictname,"w");
+	if(!dict) {
+		fprintf(stderr,"Error opening %s: %s\n",dictname,strerror(errno));
+		return 1;
+	}
+
+	for(; optind < argc; optind++) {
+		size_t srcw, srch, dstw, dsth;
+		char* end;
+		if(!(parse_size(argv[optind],&srcw,&srch,&end) && *end == ':' && parse_size(end+1,&dstw,&dsth,&end) && !*end)) {
+			fprintf(stderr,"Invalid size %s\n",argv[optind]);
+			goto end;
+		}
+		// profile expects a known resolution on both axes, which an unscaled axis wouldn't have
+		if(dstw <= srcw || dsth <= srch) {
+			fprintf(stderr,"%s: target size must be larger than the source on both axes\n",argv[optind]);
+			goto end;
+		}
+
+		float* src = malloc(sizeof(*src)*srcw*srch),* dst = malloc(sizeof(*dst)*dstw*dsth);
+		if(!(src && dst)) {
+			fprintf(stderr,"%s\n",strerror(ENOMEM));
+			free(src);
+			free(dst);
+			goto end;
+		}
+
+		for(size_t k = 0; kernels[k].name; k++) {
+			if(!use_kernel[k])
+				continue;
+
+			char filename[FILENAME_MAX];
+			if(snprintf(filename,sizeof(filename),"%s/%s_%zux%zu_%s_%zux%zu.%s",outdir,pattern == NOISE ? "noise" : "texture",
+			            srcw,srch,kernels[k].name,dstw,dsth,format == PFM ? "pfm" : "y4m") >= sizeof(filename)) {
+				fprintf(stderr,"%s\n",strerror(ENAMETOOLONG));
+				free(src);
+				free(dst);
+				goto end;
+			}
+
+			FILE* out = fopen(filename,"wb");
+			bool ok = out;
+			for(size_t frame = 0; ok && frame < frames; frame++) {
+				generate(src,srcw,srch,pattern,seed,frame);
+				ok = upscale(src,srcw,srch,dst,dstw,dsth,kernels+k) && write_frame(out,format,dst,dstw,dsth,frame);
+			}
+			if(out && fclose(out))
+				ok = false;
+			if(!ok)
+				fprintf(stderr,"Error writing %s: %s\n",filename,strerror(errno));
+			else
+				fprintf(dict,"%s\n%zu\n%zu\n\n",filename,srcw,srch);
+			if(!ok) {
+				free(src);
+				free(dst);
+				goto end;
+			}
+		}
+
+		free(src);
+		free(dst);
+	}
+	ret = 0;
+
+end:
+	if(fclose(dict) && !ret) {
+		fprintf(stderr,"Error writing %s: %s\n",dictname,strerror(errno));
+		ret = 1;
+	}
+	return ret;
+}
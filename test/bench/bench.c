@@ -0,0 +1,533 @@
+/*
+ * bench - Microbenchmarks for libresdet's transform, method kernels and image readers.
+ * Prints one JSON object per benchmark for tracking regressions.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <unistd.h>
+#ifdef HAVE_LIBPNG
+#include <png.h>
+#endif
+#ifdef HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+#include "image.h"
+
+#if defined(HAVE_FFTW)
+#define BACKEND "fftw"
+#elif defined(KISS_SIMD)
+#define BACKEND "kissfft-simd"
+#else
+#define BACKEND "kissfft"
+#endif
+
+#define MAX_REPS 1000
+#define MIN_REPS 3
+
+struct size {
+	size_t width, height;
+};
+
+static const struct size default_sizes[] = {
+	{512,512}, {1024,1024}, {2048,2048}, {4096,4096}, {8192,8192},
+	// non-square and prime
+	{1920,1080}, {1021,769},
+	{0}
+};
+
+struct bench {
+	const char* group;
+	const char* name;
+	size_t width, height;
+	// setup and teardown run around each repetition without being timed
+	bool (*setup)(void*);
+	void (*run)(void*);
+	void (*teardown)(void*);
+	void* ctx;
+};
+
+static double min_seconds = 0.25;
+static const char* filter = NULL;
+
+static bool enabled(const char* group) {
+	return !filter || strstr(group,filter);
+}
+
+static int cmp_ns(const void* left, const void* right) {
+	uint64_t l = *(const uint64_t*)left, r = *(const uint64_t*)right;
+	return l < r ? -1 : l > r;
+}
+
+static void print_json_string(const char* s) {
+	putchar('"');
+	for(; *s; s++)
+		if(*s == '"' || *s == '\\')
+			printf("\\%c",*s);
+		else
+			putchar(*s);
+	putchar('"');
+}
+
+// Repeats a benchmark until it's run for min_seconds and at least MIN_REPS times, after one untimed warmup.
+static bool measure(const struct bench* b) {
+	static uint64_t samples[MAX_REPS];
+	size_t reps = 0;
+	uint64_t total = 0;
+	for(size_t i = 0; i <= MAX_REPS && (reps < MIN_REPS || total < min_seconds*1e9); i++) {
+		if(b->setup && !b->setup(b->ctx))
+			return false;
+		uint64_t start = resdet_time_ns();
+		b->run(b->ctx);
+		uint64_t ns = resdet_time_ns() - start;
+		if(b->teardown)
+			b->teardown(b->ctx);
+		if(i) {
+			samples[reps++] = ns;
+			total += ns;
+		}
+	}
+
+	qsort(samples,reps,sizeof(*samples),cmp_ns);
+	uint64_t median = reps % 2 ? samples[reps/2] : (samples[reps/2-1] + samples[reps/2]) / 2;
+
+	printf("{\"group\":");
+	print_json_string(b->group);
+	printf(",\"name\":");
+	print_json_string(b->name);
+	printf(",\"backend\":\"" BACKEND "\",\"width\":%zu,\"height\":%zu,\"reps\":%zu,"
+	       "\"min_ns\":%llu,\"median_ns\":%llu,\"mean_ns\":%llu,\"mpixels_per_s\":%.2f}\n",
+	       b->width,b->height,reps,(unsigned long long)samples[0],(unsigned long long)median,
+	       (unsigned long long)(total/reps),b->width*b->height/(median/1e3));
+	fflush(stdout);
+	return true;
+}
+
+// Nearest neighbour 4:3 upscale of xorshift noise, so every run and size sees the same kind of input.
+static float* synthetic_image(size_t width, size_t height) {
+	size_t srcw = width*3/4 ? width*3/4 : 1, srch = height*3/4 ? height*3/4 : 1;
+	float* src = malloc(sizeof(*src)*srcw*srch),* image = malloc(sizeof(*image)*width*height);
+	if(!(src && image)) {
+		free(src);
+		free(image);
+		return NULL;
+	}
+
+	uint32_t x = 0x9E3779B9;
+	for(size_t i = 0; i < srcw*srch; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		src[i] = (x >> 8) / (float)(1 << 24);
+	}
+	for(size_t y = 0; y < height; y++)
+		for(size_t i = 0; i < width; i++)
+			image[y*width+i] = src[(y*srch/height)*srcw+i*srcw/width];
+
+	free(src);
+	return image;
+}
+
+struct transform_ctx {
+	const float* image;
+	coeff* f;
+	size_t len;
+	resdet_plan* p;
+	unsigned pass;
+};
+
+static bool copy_image(void* arg) {
+	struct transform_ctx* ctx = arg;
+	for(size_t i = 0; i < ctx->len; i++)
+		ctx->f[i] = ctx->image[i];
+	return true;
+}
+
+static void run_transform(void* arg) {
+	struct transform_ctx* ctx = arg;
+	if(ctx->pass)
+		resdet_transform_pass(ctx->p,ctx->pass);
+	else
+		resdet_transform(ctx->p);
+}
+
+static bool bench_transform(const float* image, size_t width, size_t height) {
+	bool ret = false;
+	RDError e;
+	struct transform_ctx ctx = { .image = image, .len = width*height };
+	resdet_plan* whole = NULL,* separate = NULL;
+	if(!((ctx.f    = resdet_alloc_coeffs(width,height,false)                                                  ) && /* tower of malloc failures */
+	     (whole    = resdet_create_plan(ctx.f,width,height,RESDET_TRANSFORM_2D,&e)                            ) &&
+	     (separate = resdet_create_plan(ctx.f,width,height,RESDET_TRANSFORM_2D|RESDET_TRANSFORM_SEPARATE,&e))
+	))
+		goto end;
+
+	ctx.p = whole;
+	struct bench b = { "transform", "2d", width, height, copy_image, run_transform, NULL, &ctx };
+	if(!measure(&b))
+		goto end;
+
+	// the single pass benchmarks run on a plan for each pass, as resdet_create_analysis makes when timing stages
+	ctx.p = separate;
+	b.name = "rows";
+	ctx.pass = RESDET_TRANSFORM_ROWS;
+	if(!measure(&b))
+		goto end;
+
+	b.name = "columns";
+	ctx.pass = RESDET_TRANSFORM_COLUMNS;
+	ret = measure(&b);
+
+end:
+	resdet_free_plan(whole);
+	resdet_free_plan(separate);
+	resdet_free_coeffs(ctx.f);
+	return ret;
+}
+
+struct method_ctx {
+	RDMethod* method;
+	const coeff* f;
+	const bfloat16* fb;
+	size_t length, n, stride, dist, range;
+	intermediate* result;
+	rdint_index bounds[2];
+	void* state;
+};
+
+static void run_method(void* arg) {
+	struct method_ctx* ctx = arg;
+	((RDetectFunc)ctx->method->func)(ctx->f,ctx->length,ctx->n,ctx->stride,ctx->dist,ctx->range,ctx->result,ctx->bounds,ctx->bounds+1,ctx->state);
+}
+
+static void run_method_bf16(void* arg) {
+	struct method_ctx* ctx = arg;
+	resdet_bf16_method(ctx->method)(ctx->fb,ctx->length,ctx->n,ctx->stride,ctx->dist,ctx->range,ctx->result,ctx->bounds,ctx->bounds+1,ctx->state);
+}
+
+// Times one method over every line along one axis, set up the same way resdet_create_analysis would.
+static bool bench_method_axis(struct method_ctx* ctx, const char* axis, size_t width, size_t height) {
+	char name[64];
+	bool ret = false;
+	ctx->range = strcmp(ctx->method->name,"zerox") ? resdet_default_range() : 1;
+	if(ctx->range >= (ctx->length+1)/2)
+		return true;
+
+	ctx->state = NULL;
+	ctx->bounds[0] = ctx->range;
+	ctx->bounds[1] = ctx->length - ctx->range;
+	if(!(ctx->result = calloc(ctx->length - ctx->range*2,sizeof(*ctx->result))))
+		return false;
+	if(ctx->method->init && ((RDetectInitFunc)ctx->method->init)(ctx->length,ctx->n,ctx->range,ctx->bounds,ctx->bounds+1,&ctx->state))
+		goto end;
+
+	snprintf(name,sizeof(name),"%s/%s",ctx->method->name,axis);
+	struct bench b = { "method", name, width, height, NULL, run_method, NULL, ctx };
+	if(!measure(&b))
+		goto end;
+
+	if(resdet_bf16_method(ctx->method)) {
+		snprintf(name,sizeof(name),"%s/bf16/%s",ctx->method->name,axis);
+		b.run = run_method_bf16;
+		if(!measure(&b))
+			goto end;
+	}
+	ret = true;
+
+end:
+	if(ctx->method->teardown)
+		((RDetectTeardownFunc)ctx->method->teardown)(ctx->state);
+	free(ctx->result);
+	return ret;
+}
+
+static bool bench_methods(const float* image, size_t width, size_t height) {
+	bool ret = false;
+	RDError e;
+	coeff* f = NULL;
+	bfloat16* fb = NULL;
+	resdet_plan* p = NULL;
+	if(!((f  = resdet_alloc_coeffs(width,height,false)                ) && /* tower of malloc failures */
+	     (fb = malloc(sizeof(*fb)*width*height)                       ) &&
+	     (p  = resdet_create_plan(f,width,height,RESDET_TRANSFORM_2D,&e))
+	))
+		goto end;
+
+	for(size_t i = 0; i < width*height; i++)
+		f[i] = image[i];
+	resdet_transform(p);
+	for(size_t i = 0; i < width*height; i++)
+		fb[i] = coeff_to_bf16(f[i]);
+
+	for(RDMethod* m = resdet_methods(); m->name; m++) {
+		if(!(bench_method_axis(&(struct method_ctx){ m, f, fb, width, height, width, 1 },"x",width,height) &&
+		     bench_method_axis(&(struct method_ctx){ m, f, fb, height, width, 1, width },"y",width,height)))
+			goto end;
+	}
+	ret = true;
+
+end:
+	resdet_free_plan(p);
+	free(fb);
+	resdet_free_coeffs(f);
+	return ret;
+}
+
+struct sample_file {
+	const char* ext;
+	bool (*write)(FILE*, const float*, size_t, size_t);
+	char path[FILENAME_MAX];
+};
+
+static bool write_gray8(FILE* f, const float* image, size_t len) {
+	for(size_t i = 0; i < len; i++)
+		fputc(image[i]*255+0.5f,f);
+	return !ferror(f);
+}
+
+static bool write_pgm(FILE* f, const float* image, size_t width, size_t height) {
+	fprintf(f,"P5 %zu %zu 255\n",width,height);
+	return write_gray8(f,image,width*height);
+}
+
+static bool write_pfm(FILE* f, const float* image, size_t width, size_t height) {
+	fprintf(f,"Pf\n%zu %zu\n%s\n",width,height,(union { int i; char c; }){1}.c ? "-1.0" : "1.0");
+	return fwrite(image,sizeof(*image),width*height,f) == width*height;
+}
+
+static bool write_y4m(FILE* f, const float* image, size_t width, size_t height) {
+	fprintf(f,"YUV4MPEG2 W%zu H%zu F25:1 Cmono\nFRAME\n",width,height);
+	return write_gray8(f,image,width*height);
+}
+
+#if defined(HAVE_LIBPNG) && defined(PNG_SIMPLIFIED_WRITE_STDIO_SUPPORTED)
+static bool write_png(FILE* f, const float* image, size_t width, size_t height) {
+	unsigned char* buf = malloc(width*height);
+	if(!buf)
+		return false;
+	for(size_t i = 0; i < width*height; i++)
+		buf[i] = image[i]*255+0.5f;
+
+	png_image png = { .version = PNG_IMAGE_VERSION, .width = width, .height = height, .format = PNG_FORMAT_GRAY };
+	bool ret = png_image_write_to_stdio(&png,f,0,buf,0,NULL);
+	png_image_free(&png);
+	free(buf);
+	return ret;
+}
+#endif
+
+#ifdef HAVE_LIBJPEG
+static bool write_jpeg(FILE* f, const float* image, size_t width, size_t height) {
+	unsigned char* row = malloc(width);
+	if(!row)
+		return false;
+
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_stdio_dest(&cinfo,f);
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = 1;
+	cinfo.in_color_space = JCS_GRAYSCALE;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo,95,TRUE);
+	jpeg_start_compress(&cinfo,TRUE);
+	while(cinfo.next_scanline < height) {
+		const float* src = image + cinfo.next_scanline*width;
+		for(size_t i = 0; i < width; i++)
+			row[i] = src[i]*255+0.5f;
+		jpeg_write_scanlines(&cinfo,&row,1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	free(row);
+	return !ferror(f);
+}
+#endif
+
+static struct sample_file sample_files[] = {
+	{ "pgm", write_pgm },
+	{ "pfm", write_pfm },
+	{ "y4m", write_y4m },
+#if defined(HAVE_LIBPNG) && defined(PNG_SIMPLIFIED_WRITE_STDIO_SUPPORTED)
+	{ "png", write_png },
+#endif
+#ifdef HAVE_LIBJPEG
+	{ "jpg", write_jpeg },
+#endif
+	{ NULL }
+};
+
+// Readers are opened through the public API so this follows however open_image drives them.
+struct reader_ctx {
+	const char* reader;
+	const char* path;
+	RDImage* rdimage;
+	float* image;
+	size_t width, height;
+};
+
+static bool open_reader(void* arg) {
+	struct reader_ctx* ctx = arg;
+	size_t width, height;
+	if(!(ctx->rdimage = resdet_open_image_with_reader(ctx->path,ctx->reader,&width,&height,NULL,NULL)))
+		return false;
+	if(width != ctx->width || height != ctx->height) {
+		resdet_close_image(ctx->rdimage);
+		return false;
+	}
+	return true;
+}
+
+static void run_reader(void* arg) {
+	struct reader_ctx* ctx = arg;
+	resdet_read_image_frame(ctx->rdimage,ctx->image,NULL);
+}
+
+static void close_reader(void* arg) {
+	struct reader_ctx* ctx = arg;
+	resdet_close_image(ctx->rdimage);
+}
+
+static void remove_sample_files(void) {
+	for(struct sample_file* s = sample_files; s->ext; s++)
+		if(*s->path) {
+			remove(s->path);
+			*s->path = '\0';
+		}
+}
+
+static bool write_sample_files(const float* image, size_t width, size_t height) {
+	const char* tmpdir = getenv("TMPDIR");
+	if(!tmpdir)
+		tmpdir = "/tmp";
+
+	for(struct sample_file* s = sample_files; s->ext; s++) {
+		snprintf(s->path,sizeof(s->path),"%s/resdet-bench-XXXXXX",tmpdir);
+		int fd = mkstemp(s->path);
+		FILE* f = fd < 0 ? NULL : fdopen(fd,"wb");
+		if(!f) {
+			if(fd >= 0)
+				close(fd);
+			perror(s->path);
+			return false;
+		}
+		bool ok = s->write(f,image,width,height);
+		if(fclose(f) || !ok) {
+			fprintf(stderr,"%s: failed writing %s sample\n",s->path,s->ext);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Times decoding the same image from each format each reader accepts.
+// Files are read back from the page cache, so this excludes disk speed.
+static bool bench_readers(const float* image, size_t width, size_t height) {
+	bool ret = false;
+	struct reader_ctx ctx = { .width = width, .height = height };
+	if(!(ctx.image = malloc(sizeof(*ctx.image)*width*height)))
+		return false;
+	if(!write_sample_files(image,width,height))
+		goto end;
+
+	const char* const* names = resdet_list_image_readers();
+	for(size_t i = 0; names[i]; i++) {
+		ctx.reader = names[i];
+		for(struct sample_file* s = sample_files; s->ext; s++) {
+			ctx.path = s->path;
+			if(!open_reader(&ctx))
+				continue;
+			close_reader(&ctx);
+
+			char name[64];
+			snprintf(name,sizeof(name),"%s/%s",names[i],s->ext);
+			struct bench b = { "reader", name, width, height, open_reader, run_reader, close_reader, &ctx };
+			if(!measure(&b))
+				goto end;
+		}
+	}
+	ret = true;
+
+end:
+	remove_sample_files();
+	free(ctx.image);
+	return ret;
+}
+
+static bool parse_sizes(char* arg, struct size** sizes) {
+	size_t n = 1;
+	for(char* c = arg; *c; c++)
+		n += *c == ',';
+	if(!(*sizes = calloc(n+1,sizeof(**sizes))))
+		return false;
+
+	char* token;
+	for(size_t i = 0; (token = strtok(i ? NULL : arg,",")); i++) {
+		char* end;
+		(*sizes)[i].width = strtoull(token,&end,10);
+		if(*end == 'x')
+			(*sizes)[i].height = strtoull(end+1,&end,10);
+		if(*end || !(*sizes)[i].width || !(*sizes)[i].height)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	struct size* sizes = NULL;
+	int opt;
+	while((opt = getopt(argc,argv,"t:s:")) != -1)
+		switch(opt) {
+			case 't': {
+				char* end;
+				min_seconds = strtod(optarg,&end);
+				if(end == optarg || *end || min_seconds < 0) {
+					fprintf(stderr,"Invalid time %s\n",optarg);
+					return 1;
+				}
+			} break;
+			case 's':
+				free(sizes);
+				if(!parse_sizes(optarg,&sizes)) {
+					fprintf(stderr,"Invalid sizes %s\n",optarg);
+					free(sizes);
+					return 1;
+				}
+				break;
+			default:
+				fprintf(stderr,
+"Usage: %s [-t seconds] [-s WxH,...] [transform|method|reader]\n"
+"\n"
+"-t minimum time to repeat each benchmark for (default %g)\n"
+"-s sizes to benchmark (default 512x512 up to 8192x8192, plus 1920x1080 and 1021x769)\n"
+"\n"
+"Results are printed as one JSON object per line.\n"
+				,argv[0],min_seconds);
+				return 1;
+		}
+	if(optind < argc)
+		filter = argv[optind];
+
+	int ret = 0;
+	for(const struct size* s = sizes ? sizes : default_sizes; s->width; s++) {
+		float* image = synthetic_image(s->width,s->height);
+		if(!(image &&
+		     (!enabled("transform") || bench_transform(image,s->width,s->height)) &&
+		     (!enabled("method")    || bench_methods(image,s->width,s->height)) &&
+		     (!enabled("reader")    || bench_readers(image,s->width,s->height))
+		)) {
+			fprintf(stderr,"Benchmarks failed at %zux%zu\n",s->width,s->height);
+			ret = 1;
+		}
+		free(image);
+		if(ret)
+			break;
+	}
+
+	free(sizes);
+	return ret;
+}
@@ -197,3 +197,127 @@ test_nframes_and_offset_work_together() {
 
 	assert_equals "$output" "$(resdet -n1 -o1 -p ../files/checkerboard.pfm 2>&1 > /dev/null)"
 }
+
+test_multiple_images_print_each_result() {
+	output="\
+../files/blue_marble_2012_resized.pfm$CR
+512 512$CR
+../files/checkerboard.pfm$CR
+2 2"
+
+	assert_equals "$output" "$(resdet -v1 -j1 ../files/blue_marble_2012_resized.pfm ../files/checkerboard.pfm)"
+}
+
+test_list_option_reads_images_from_file() {
+	output="\
+../files/checkerboard.pfm$CR
+2 2"
+
+	assert_equals "$output" "$(echo ../files/checkerboard.pfm | resdet -v1 -l -)"
+}
+
+test_multiple_images_fail_if_any_cant_be_read() {
+	assert_fails "resdet -v1 ../files/checkerboard.pfm ../files/doesntexist.pfm"
+	assert_equals "../files/doesntexist.pfm: No such file or directory" "$(resdet -v1 ../files/checkerboard.pfm ../files/doesntexist.pfm 2>&1 > /dev/null)"
+}
+
+test_single_image_options_with_multiple_images_print_error() {
+	assert_fails "resdet -p ../files/checkerboard.pfm ../files/checkerboard.pfm"
+}
+
+test_json_output_format() {
+	output="\
+\\{\"file\":\"\\.\\./files/blue_marble_2012_resized\\.pfm\",\"width\":768,\"height\":768,\"frames\":1,\"seconds\":[[:digit:].]+,\
+\"widths\":\\[\\{\"size\":512,\"confidence\":0\\.[[:digit:]]+\\}\\],\"heights\":\\[\\{\"size\":512,\"confidence\":0\\.[[:digit:]]+\\}\\]\\}$"
+
+	assert_matches "$output" "$(resdet -O json ../files/blue_marble_2012_resized.pfm)"
+}
+
+test_csv_output_format() {
+	output="\
+file,width,height,frames,seconds,widths,heights,error$CR
+\\.\\./files/checkerboard\\.pfm,2,2,2,[[:digit:].]+,,,$"
+
+	assert_matches "$output" "$(resdet -O csv ../files/checkerboard.pfm)"
+}
+
+test_output_format_records_errors() {
+	assert_fails "resdet -O json ../files/checkerboard.pfm ../files/doesntexist.pfm"
+	assert_equals '{"file":"../files/doesntexist.pfm","error":"No such file or directory"}' "$(resdet -O json ../files/doesntexist.pfm 2> /dev/null)"
+}
+
+test_invalid_output_format_prints_error() {
+	assert_fails "resdet -O xml ../files/checkerboard.pfm"
+}
+
+test_serve_answers_requests_from_stdin() {
+	output="\
+\\{\"id\":1,\"file\":\"\\.\\./files/checkerboard\\.pfm\",\"width\":2,\"height\":2,\"frames\":2,\"seconds\":[[:digit:].]+,\"widths\":\\[\\],\"heights\":\\[\\]\\}$"
+
+	assert_matches "$output" "$(echo '{"id":1,"path":"../files/checkerboard.pfm"}' | resdet -S -)"
+}
+
+test_serve_answers_requests_with_image_data() {
+	output="\
+\\{\"id\":1,\"width\":2,\"height\":2,\"frames\":2,\"seconds\":[[:digit:].]+,\"widths\":\\[\\],\"heights\":\\[\\]\\}$"
+	data=$(base64 < ../files/checkerboard.pfm | tr -d '\n')
+
+	assert_matches "$output" "$(echo "{\"id\":1,\"type\":\"pfm\",\"data\":\"$data\"}" | resdet -S -)"
+}
+
+test_serve_answers_requests_with_pixels() {
+	output="\
+\\{\"id\":1,\"width\":2,\"height\":2,\"frames\":2,\"seconds\":[[:digit:].]+,\"widths\":\\[\\],\"heights\":\\[\\]\\}$"
+	# two 2x2 checkerboard frames. 3f80803f reads the same in either byte order, so this is host independent.
+	pixels=$(printf '\0\0\0\0\x3f\x80\x80\x3f\x3f\x80\x80\x3f\0\0\0\0\x3f\x80\x80\x3f\0\0\0\0\0\0\0\0\x3f\x80\x80\x3f' | base64 | tr -d '\n')
+
+	assert_matches "$output" "$(echo "{\"id\":1,\"width\":2,\"height\":2,\"pixels\":\"$pixels\"}" | resdet -S -)"
+}
+
+# Sends one request line to the Unix socket $1 and prints the response.
+socket_request() {
+	python3 -c 'import socket,sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.sendall(sys.argv[2].encode() + b"\n")
+s.shutdown(socket.SHUT_WR)
+sys.stdout.write(s.makefile().read())' "$1" "$2"
+}
+
+test_serve_answers_requests_on_a_unix_socket() {
+	output="\
+\\{\"id\":[12],\"file\":\"\\.\\./files/checkerboard\\.pfm\",\"width\":2,\"height\":2,\"frames\":2,\"seconds\":[[:digit:].]+,\"widths\":\\[\\],\"heights\":\\[\\]\\}$"
+	socket=$(mktemp -u "${TMPDIR:-/tmp}/resdet_test.XXXXXX")
+	resdet -S "$socket" &
+	pid=$!
+	for i in $(seq 50); do
+		[ -S "$socket" ] && break
+		sleep 0.1
+	done
+
+	# each request is its own connection, so the second one also checks the server keeps accepting
+	first=$(socket_request "$socket" '{"id":1,"path":"../files/checkerboard.pfm"}')
+	second=$(socket_request "$socket" '{"id":2,"path":"../files/checkerboard.pfm"}')
+	kill $pid
+	wait $pid 2> /dev/null
+	rm -f "$socket"
+
+	assert_matches "$output" "$first"
+	assert_matches "$output" "$second"
+}
+
+test_serve_reports_invalid_requests() {
+	assert_equals '{"id":"a","error":"Invalid request"}' "$(echo '{"id":"a","path":[]}' | resdet -S -)"
+	assert_equals '{"id":2,"file":"../files/doesntexist.pfm","error":"No such file or directory"}' "$(echo '{"id":2,"path":"../files/doesntexist.pfm"}' | resdet -S -)"
+	assert_equals '{"id":3,"error":"Invalid request"}' "$(echo '{"id":3,"path":"../files/checkerboard.pfm","threshold":-5}' | resdet -S -)"
+	assert_equals '{"id":4,"error":"Invalid request"}' "$(echo '{"id":4,"path":"../files/checkerboard.pfm","frames":1e30}' | resdet -S -)"
+	assert_equals '{"id":5,"error":"Pixel dimensions are too large"}' "$(echo '{"id":5,"width":4294967296,"height":4294967296,"pixels":"AAAAAA=="}' | resdet -S -)"
+}
+
+test_serve_with_images_prints_error() {
+	assert_fails "resdet -S - ../files/checkerboard.pfm"
+}
+
+test_stats_prints_stage_table() {
+	assert_matches "^stage .*decode +2 " "$(resdet -s ../files/checkerboard.pfm 2>&1 > /dev/null | tr '\n' ' ')"
+}
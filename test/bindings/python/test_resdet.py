@@ -187,6 +187,25 @@ class TestResdet:
         assert buffer.shape() == (2, 2)
         assert list(buffer) == test_file_frames[0]
 
+    def test_reads_image_from_bytes(self, test_file_frames):
+        with open(test_file, "rb") as f:
+            data = f.read()
+        buffer = resdet.ImageBuffer()
+        rdimage = resdet.Image.from_bytes(data, "pfm", buffer = buffer)
+
+        assert rdimage.read_image_frame(buffer)
+        assert buffer.shape() == (2, 2)
+        assert list(buffer) == test_file_frames[0]
+
+    def test_reads_image_from_fd(self, test_file_frames):
+        buffer = resdet.ImageBuffer()
+        with open(test_file, "rb") as f:
+            rdimage = resdet.Image.from_fd(f.fileno(), "pfm", buffer = buffer)
+
+        assert rdimage.read_image_frame(buffer)
+        assert buffer.shape() == (2, 2)
+        assert list(buffer) == test_file_frames[0]
+
     def test_reads_image_with_context_managers(self, test_file_frames):
         with resdet.ImageBuffer() as buffer:
             with resdet.Image(test_file, buffer = buffer) as rdimage:
@@ -206,6 +225,14 @@ class TestResdet:
         assert nframes == 2
         assert frames == test_file_frames[0] + test_file_frames[1]
 
+    def test_reads_frames_into_store(self, test_file_frames):
+        with resdet.Frames(test_file) as frames:
+            assert (frames.width, frames.height) == (2, 2)
+            assert len(frames) == 2
+            assert [frame[:4] for frame in frames] == test_file_frames
+            with pytest.raises(IndexError):
+                frames[2]
+
 class TestResdetNumPy:
     def test_resdetect_numpy_array(self, numpy_array, test_file_resolution_dict):
         resolutions = resdet.resdetect(numpy_array)
@@ -3,24 +3,39 @@
 struct analysis_ctx {
 	RDAnalysis* analysis;
 	float* image;
+	RDParameters* params;
+	RDResolution* resw,* resh;
+	size_t countw, counth;
+	// every resolution a full analysis with the sign method considers, for comparison
+	RDResolution* fullw,* fullh;
+	size_t fullcountw, fullcounth;
 };
 
 int setup_analysis_group(void** state) {
-	struct analysis_ctx* ctx = malloc(sizeof(*ctx));
+	struct analysis_ctx* ctx = calloc(1,sizeof(*ctx));
 	if(!ctx)
 		return 1;
+	*state = ctx;
 
 	size_t width, height, nimages;
 	RDError err = resdet_read_image("test/files/blue_marble_2012_resized.pfm",NULL,&ctx->image,&nimages,&width,&height);
 	if(err)
 		return 1;
 
-	*state = ctx;
+	RDParameters* params = resdet_alloc_default_parameters();
+	if(params && !(err = resdet_parameters_set_threshold(params,0)))
+		err = resdetect(ctx->image,1,768,768,&ctx->fullw,&ctx->fullcountw,&ctx->fullh,&ctx->fullcounth,resdet_get_method("sign"),params);
+	free(params);
+	if(!params || err)
+		return 1;
+
 	return 0;
 }
 
 int teardown_analysis_group(void** state) {
 	struct analysis_ctx* ctx = *state;
+	free(ctx->fullw);
+	free(ctx->fullh);
 	free(ctx->image);
 	free(ctx);
 	return 0;
@@ -39,6 +54,49 @@ int teardown_analysis_tests(void** state) {
 	return 0;
 }
 
+int setup_analysis_parameters_tests(void** state) {
+	struct analysis_ctx* ctx = *state;
+	ctx->analysis = NULL;
+	ctx->resw = ctx->resh = NULL;
+	ctx->countw = ctx->counth = 0;
+	if(!(ctx->params = resdet_alloc_default_parameters()))
+		return 1;
+	return 0;
+}
+
+int teardown_analysis_parameters_tests(void** state) {
+	struct analysis_ctx* ctx = *state;
+	resdet_destroy_analysis(ctx->analysis);
+	free(ctx->params);
+	free(ctx->resw);
+	free(ctx->resh);
+	return 0;
+}
+
+// Analyzes the sample image with the sign method and ctx->params, leaving the analysis and its results in ctx.
+static RDError analyze_with_parameters(struct analysis_ctx* ctx) {
+	RDError err;
+	if(!(ctx->analysis = resdet_create_analysis(resdet_get_method("sign"),768,768,ctx->params,&err)))
+		return err;
+	if((err = resdet_analyze_image(ctx->analysis,ctx->image)))
+		return err;
+	return resdet_analysis_results(ctx->analysis,&ctx->resw,&ctx->countw,&ctx->resh,&ctx->counth);
+}
+
+// Checks that res has the same best resolution as the full analysis, and that every resolution in it
+// has a confidence within tolerance of the full analysis' confidence for that resolution.
+static void assert_results_match_full(const RDResolution* res, size_t count, const RDResolution* full, size_t fullcount, float tolerance) {
+	assert_true(count > 0);
+	assert_uint_equal(res[0].index,full[0].index);
+	for(size_t i = 0; i < count; i++) {
+		size_t j = 0;
+		while(j < fullcount && full[j].index != res[i].index)
+			j++;
+		assert_true(j < fullcount);
+		assert_float_equal(res[i].confidence,full[j].confidence,tolerance);
+	}
+}
+
 // teardown: teardown_analysis_tests
 void test_creates_analysis(void** state) {
 	struct analysis_ctx* ctx = *state;
@@ -169,3 +227,196 @@ void test_analysis_detects_resolutions(void** state) {
 
 	run_sample_image_assertions(resw,resh,countw,counth,2,2);
 }
+
+struct counting_allocator {
+	size_t allocs, frees;
+};
+
+static struct counting_allocator counts;
+
+static void* counting_malloc(void* opaque, size_t size) {
+	((struct counting_allocator*)opaque)->allocs++;
+	return malloc(size);
+}
+
+static void counting_free(void* opaque, void* ptr) {
+	((struct counting_allocator*)opaque)->frees++;
+	free(ptr);
+}
+
+int setup_analysis_allocator_tests(void** state) {
+	struct analysis_ctx* ctx = *state;
+	ctx->analysis = NULL;
+	counts = (struct counting_allocator){0};
+	return resdet_set_allocator(&(RDAllocator){ .malloc_fn = counting_malloc, .free_fn = counting_free, .opaque = &counts }) != RDEOK;
+}
+
+int teardown_analysis_allocator_tests(void** state) {
+	teardown_analysis_tests(state);
+	resdet_set_allocator(NULL);
+	return 0;
+}
+
+// setup: setup_analysis_allocator_tests
+// teardown: teardown_analysis_allocator_tests
+void test_analysis_uses_custom_allocator(void** state) {
+	struct analysis_ctx* ctx = *state;
+	RDError err;
+
+	ctx->analysis = resdet_create_analysis(resdet_get_method("orig"),768,768,NULL,&err);
+	if(!err)
+		err = resdet_analyze_image(ctx->analysis,ctx->image);
+	resdet_destroy_analysis(ctx->analysis);
+	ctx->analysis = NULL;
+
+	assert_false(err);
+	assert_true(counts.allocs > 0);
+	assert_uint_equal(counts.allocs,counts.frees);
+}
+
+// guard: HAVE_MADV_HUGEPAGE
+// setup: setup_analysis_parameters_tests
+// teardown: teardown_analysis_parameters_tests
+void test_huge_pages_analysis_matches_full_analysis(void** state) {
+	struct analysis_ctx* ctx = *state;
+	resdet_parameters_set_threshold(ctx->params,0);
+	resdet_parameters_set_huge_pages(ctx->params,true);
+
+	RDError err = analyze_with_parameters(ctx);
+
+	assert_false(err);
+	assert_uint_equal(ctx->countw,ctx->fullcountw);
+	assert_uint_equal(ctx->counth,ctx->fullcounth);
+	assert_results_match_full(ctx->resw,ctx->countw,ctx->fullw,ctx->fullcountw,0);
+	assert_results_match_full(ctx->resh,ctx->counth,ctx->fullh,ctx->fullcounth,0);
+}
+
+// setup: setup_analysis_parameters_tests
+// teardown: teardown_analysis_parameters_tests
+void test_coarse_analysis_matches_full_analysis(void** state) {
+	struct analysis_ctx* ctx = *state;
+	resdet_parameters_set_coarse_fraction(ctx->params,0.5);
+
+	RDError err = analyze_with_parameters(ctx);
+
+	assert_false(err);
+	assert_results_match_full(ctx->resw,ctx->countw,ctx->fullw,ctx->fullcountw,0.15);
+	assert_results_match_full(ctx->resh,ctx->counth,ctx->fullh,ctx->fullcounth,0.15);
+}
+
+// setup: setup_analysis_parameters_tests
+// teardown: teardown_analysis_parameters_tests
+void test_line_sampling_matches_full_analysis(void** state) {
+	struct analysis_ctx* ctx = *state;
+	resdet_parameters_set_line_sampling(ctx->params,4,true);
+
+	RDError err = analyze_with_parameters(ctx);
+
+	assert_false(err);
+	assert_results_match_full(ctx->resw,ctx->countw,ctx->fullw,ctx->fullcountw,0.05);
+	assert_results_match_full(ctx->resh,ctx->counth,ctx->fullh,ctx->fullcounth,0.05);
+}
+
+// setup: setup_analysis_parameters_tests
+// teardown: teardown_analysis_parameters_tests
+void test_single_axis_analysis_only_detects_that_axis(void** state) {
+	struct analysis_ctx* ctx = *state;
+	resdet_parameters_set_axes(ctx->params,true,false);
+
+	RDError err = analyze_with_parameters(ctx);
+
+	assert_false(err);
+	assert_true(ctx->countw > 1);
+	assert_uint_equal(ctx->resw[0].index,512);
+	assert_uint_equal(ctx->counth,1);
+	assert_uint_equal(ctx->resh[0].index,768);
+}
+
+// setup: setup_analysis_parameters_tests
+// teardown: teardown_analysis_parameters_tests
+void test_top_results_match_full_results(void** state) {
+	struct analysis_ctx* ctx = *state;
+	RDResolution topw[8], toph[8];
+	size_t topcountw = 8, topcounth = 8;
+	resdet_parameters_set_threshold(ctx->params,0);
+
+	RDError err = analyze_with_parameters(ctx);
+	if(!err)
+		err = resdet_analysis_top_results(ctx->analysis,topw,&topcountw,toph,&topcounth);
+
+	assert_false(err);
+	assert_uint_equal(topcountw,8);
+	assert_uint_equal(topcounth,8);
+	assert_uint_equal(topw[0].index,ctx->resw[0].index);
+	assert_uint_equal(toph[0].index,ctx->resh[0].index);
+	for(size_t i = 0; i < 8; i++) {
+		assert_float_equal(topw[i].confidence,ctx->resw[i].confidence,0);
+		assert_float_equal(toph[i].confidence,ctx->resh[i].confidence,0);
+	}
+}
+
+// setup: setup_analysis_tests
+// teardown: teardown_analysis_tests
+void test_top_results_with_no_images_returns_error(void** state) {
+	struct analysis_ctx* ctx = *state;
+	RDResolution resw[1];
+	size_t countw = 1;
+
+	RDError err = resdet_analysis_top_results(ctx->analysis,resw,&countw,NULL,NULL);
+
+	assert_int_equal(err,RDENOIMG);
+	assert_uint_equal(countw,0);
+}
+
+// setup: setup_analysis_tests
+// teardown: teardown_analysis_tests
+void test_reset_analysis_discards_images(void** state) {
+	struct analysis_ctx* ctx = *state;
+	RDResolution* resw,* resh;
+	size_t countw, counth;
+
+	RDError err = resdet_analyze_image(ctx->analysis,ctx->image);
+
+	assert_false(err);
+
+	resdet_reset_analysis(ctx->analysis);
+	err = resdet_analysis_results(ctx->analysis,&resw,&countw,&resh,&counth);
+
+	assert_int_equal(err,RDENOIMG);
+}
+
+// setup: setup_analysis_parameters_tests
+// teardown: teardown_analysis_parameters_tests
+void test_analysis_stats_count_each_stage(void** state) {
+	struct analysis_ctx* ctx = *state;
+	RDStats stats = {0};
+	resdet_parameters_set_stats(ctx->params,true);
+
+	RDError err = analyze_with_parameters(ctx);
+	if(!err)
+		err = resdet_analysis_stats(ctx->analysis,&stats);
+
+	assert_false(err);
+	assert_uint_equal(stats.stages[RDSTAGE_DECODE].count,0);
+	assert_uint_equal(stats.stages[RDSTAGE_COPY].count,1);
+	assert_uint_equal(stats.stages[RDSTAGE_ROW_TRANSFORM].count,1);
+	assert_uint_equal(stats.stages[RDSTAGE_COLUMN_TRANSFORM].count,1);
+	assert_uint_equal(stats.stages[RDSTAGE_DETECT_X].count,1);
+	assert_uint_equal(stats.stages[RDSTAGE_DETECT_Y].count,1);
+	assert_uint_equal(stats.stages[RDSTAGE_RESULTS].count,2);
+}
+
+// setup: setup_analysis_tests
+// teardown: teardown_analysis_tests
+void test_analysis_stats_are_empty_unless_enabled(void** state) {
+	struct analysis_ctx* ctx = *state;
+	RDStats stats = {0};
+
+	RDError err = resdet_analyze_image(ctx->analysis,ctx->image);
+	if(!err)
+		err = resdet_analysis_stats(ctx->analysis,&stats);
+
+	assert_false(err);
+	for(int i = 0; i < RDSTAGE_COUNT; i++)
+		assert_uint_equal(stats.stages[i].count,0);
+}
@@ -1,8 +1,12 @@
 #include "test.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 struct image_ctx {
 	float* imagebuf;
 	RDImage* image;
+	RDFrames* frames;
 };
 
 int setup_image_group(void** state) {
@@ -47,6 +51,12 @@ int teardown_rdimage_tests(void** state) {
 	return 0;
 }
 
+int teardown_frames_tests(void** state) {
+	struct image_ctx* ctx = *state;
+	resdet_free_frames(ctx->frames);
+	return 0;
+}
+
 void test_lists_image_readers(void** state) {
 	const char* const* image_readers = resdet_list_image_readers();
 
@@ -72,6 +82,59 @@ void test_opens_image(void** state) {
 	assert_uint_equal(height,2);
 }
 
+// guard: HAVE_FMEMOPEN
+// teardown: teardown_image_tests
+void test_opens_image_from_memory(void** state) {
+	struct image_ctx* ctx = *state;
+	static const char pgm[] = "P5 2 2 255\n\xff\x00\x00\xff";
+	size_t width, height;
+	RDError err;
+
+	ctx->image = resdet_open_image_mem(pgm,sizeof(pgm)-1,"pgm",&width,&height,&ctx->imagebuf,&err);
+
+	assert_false(err);
+	assert_non_null(ctx->image);
+	assert_uint_equal(width,2);
+	assert_uint_equal(height,2);
+	assert_true(resdet_read_image_frame(ctx->image,ctx->imagebuf,&err));
+	assert_array_equal(ctx->imagebuf,((float[]){
+		1, 0,
+		0, 1
+	}));
+}
+
+void test_open_image_mem_without_type_returns_error(void** state) {
+	static const char pgm[] = "P5 2 2 255\n\xff\x00\x00\xff";
+	size_t width, height;
+	RDError err;
+
+	RDImage* image = resdet_open_image_mem(pgm,sizeof(pgm)-1,NULL,&width,&height,NULL,&err);
+
+	assert_null(image);
+	assert_int_equal(err,RDEPARAM);
+}
+
+// teardown: teardown_image_tests
+void test_opens_image_from_fd(void** state) {
+	struct image_ctx* ctx = *state;
+	size_t width, height;
+	RDError err;
+
+	int fd = open("test/files/checkerboard.pfm",O_RDONLY);
+	assert_true(fd >= 0);
+	ctx->image = resdet_open_image_fd(fd,"pfm",&width,&height,&ctx->imagebuf,&err);
+	close(fd);
+
+	assert_false(err);
+	assert_non_null(ctx->image);
+	assert_uint_equal(width,2);
+	assert_uint_equal(height,2);
+	assert_true(resdet_read_image_frame(ctx->image,ctx->imagebuf,&err));
+	assert_true(resdet_read_image_frame(ctx->image,ctx->imagebuf,&err));
+	assert_false(resdet_read_image_frame(ctx->image,ctx->imagebuf,&err));
+	assert_false(err);
+}
+
 // teardown: teardown_rdimage_tests
 void test_imagebuf_can_be_null(void** state) {
 	struct image_ctx* ctx = *state;
@@ -228,6 +291,41 @@ void test_reads_multi_frame_image(void** state) {
 	}));
 }
 
+// teardown: teardown_frames_tests
+void test_reads_frames_into_store(void** state) {
+	struct image_ctx* ctx = *state;
+	size_t width, height, nframes;
+	RDError err;
+
+	ctx->frames = resdet_read_frames("test/files/checkerboard.pfm",NULL,&width,&height,&nframes,&err);
+
+	assert_false(err);
+	assert_non_null(ctx->frames);
+	assert_uint_equal(nframes,2);
+	assert_uint_equal(width,2);
+	assert_uint_equal(height,2);
+	assert_array_equal(resdet_get_frame(ctx->frames,0),((float[]){
+		1, 0,
+		0, 1
+	}));
+	assert_array_equal(resdet_get_frame(ctx->frames,1),((float[]){
+		0, 1,
+		1, 0
+	}));
+	assert_null(resdet_get_frame(ctx->frames,2));
+}
+
+void test_reading_frames_from_partial_data_returns_error(void** state) {
+	size_t width, height, nframes;
+	RDError err;
+
+	RDFrames* frames = resdet_read_frames("test/files/partial_data.pfm",NULL,&width,&height,&nframes,&err);
+
+	assert_null(frames);
+	assert_int_equal(err,RDEINVAL);
+	assert_uint_equal(nframes,0);
+}
+
 // setup: setup_image_tests
 // teardown: teardown_image_tests
 void test_reads_image_frames(void** state) {
@@ -258,6 +356,23 @@ void test_reads_image_frames(void** state) {
 	assert_false(err);
 }
 
+// setup: setup_image_tests
+// teardown: teardown_image_tests
+void test_image_stats_count_decoded_frames(void** state) {
+	struct image_ctx* ctx = *state;
+	RDStats stats = {0};
+	RDError err = resdet_image_set_stats(ctx->image,true);
+
+	while(!err && resdet_read_image_frame(ctx->image,ctx->imagebuf,&err))
+		;
+	if(!err)
+		err = resdet_image_stats(ctx->image,&stats);
+
+	assert_false(err);
+	assert_uint_equal(stats.stages[RDSTAGE_DECODE].count,2);
+	assert_uint_equal(stats.stages[RDSTAGE_COPY].count,0);
+}
+
 // setup: setup_image_tests
 void test_reading_with_null_rdimage_returns_error(void** state) {
 	struct image_ctx* ctx = *state;
@@ -280,3 +395,54 @@ void test_reading_with_null_image_buffer_returns_error(void** state) {
 	assert_false(ret);
 	assert_int_equal(err,RDEPARAM);
 }
+
+struct counting_allocator {
+	size_t allocs, frees;
+};
+
+static struct counting_allocator counts;
+
+static void* counting_malloc(void* opaque, size_t size) {
+	((struct counting_allocator*)opaque)->allocs++;
+	return malloc(size);
+}
+
+static void counting_free(void* opaque, void* ptr) {
+	((struct counting_allocator*)opaque)->frees++;
+	free(ptr);
+}
+
+int setup_image_allocator_tests(void** state) {
+	struct image_ctx* ctx = *state;
+	ctx->image = NULL;
+	ctx->imagebuf = NULL;
+	counts = (struct counting_allocator){0};
+	return resdet_set_allocator(&(RDAllocator){ .malloc_fn = counting_malloc, .free_fn = counting_free, .opaque = &counts }) != RDEOK;
+}
+
+int teardown_image_allocator_tests(void** state) {
+	teardown_image_tests(state);
+	resdet_set_allocator(NULL);
+	return 0;
+}
+
+// setup: setup_image_allocator_tests
+// teardown: teardown_image_allocator_tests
+void test_image_readers_use_custom_allocator(void** state) {
+	struct image_ctx* ctx = *state;
+	size_t width, height;
+	RDError err;
+
+	ctx->image = resdet_open_image("test/files/checkerboard_rgb.pfm",NULL,&width,&height,&ctx->imagebuf,&err);
+
+	assert_false(err);
+	while(resdet_read_image_frame(ctx->image,ctx->imagebuf,&err))
+		;
+	assert_false(err);
+
+	resdet_close_image(ctx->image);
+	ctx->image = NULL;
+
+	assert_true(counts.allocs > 0);
+	assert_uint_equal(counts.allocs,counts.frees);
+}
@@ -443,7 +443,7 @@ void test_reads_png(void** state) {
 
 // setup: setup_jpg_tests
 // teardown: teardown_image_reader_tests
-// guard: HAVE_LIBJPEG
+// guard: HAVE_LIBJPEG&&!defined(LIBJPEG_FAST_DCT)
 void test_reads_jpg(void** state) {
 	run_still_frame_reads_test(state);
 }
@@ -758,3 +758,32 @@ void test_read_frame_errors_on_partial_data_y4m(void** state) {
 	run_read_frame_errors_on_partial_data_test(state);
 }
 
+
+int setup_rgb_pfm_tests(void** state) {
+	struct image_reader_ctx* ctx = *state;
+	size_t width, height;
+	if(!(ctx->image = resdet_open_image_with_reader("test/files/checkerboard_rgb.pfm","PFM",&width,&height,&ctx->imagebuf,NULL)))
+		return 1;
+	return 0;
+}
+
+// setup: setup_rgb_pfm_tests
+// teardown: teardown_image_reader_tests
+void test_reads_rgb_pfm(void** state) {
+	run_multi_frame_reads_test(state);
+}
+
+int setup_interlaced_png_tests(void** state) {
+	struct image_reader_ctx* ctx = *state;
+	size_t width, height;
+	if(!(ctx->image = resdet_open_image_with_reader("test/files/checkerboard_interlaced.png","libpng",&width,&height,&ctx->imagebuf,NULL)))
+		return 1;
+	return 0;
+}
+
+// setup: setup_interlaced_png_tests
+// teardown: teardown_image_reader_tests
+// guard: HAVE_LIBPNG
+void test_reads_interlaced_png(void** state) {
+	run_still_frame_reads_test(state);
+}
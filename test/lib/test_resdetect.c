@@ -2,6 +2,9 @@
 
 struct image_ctx {
 	float* image;
+	RDParameters* params;
+	RDResolution* resw,* resh;
+	size_t countw, counth;
 };
 
 int setup_resdetect_group(void** state) {
@@ -21,6 +24,26 @@ int teardown_resdetect_group(void** state) {
 	return 0;
 }
 
+int setup_resdetect_parameters_tests(void** state) {
+	struct image_ctx* ctx = calloc(1,sizeof(*ctx));
+	if(!ctx)
+		return 1;
+	ctx->image = *state;
+	*state = ctx;
+	if(!(ctx->params = resdet_alloc_default_parameters()))
+		return 1;
+	return 0;
+}
+
+int teardown_resdetect_parameters_tests(void** state) {
+	struct image_ctx* ctx = *state;
+	free(ctx->params);
+	free(ctx->resw);
+	free(ctx->resh);
+	free(ctx);
+	return 0;
+}
+
 void test_resdetect_detects_resolutions(void** state) {
 	float* image = *state;
 	RDResolution* resw,* resh;
@@ -97,40 +120,30 @@ void test_zerox_method(void** state) {
 	run_method_tests(state,"zerox",3,3);
 }
 
+// setup: setup_resdetect_parameters_tests
+// teardown: teardown_resdetect_parameters_tests
 void test_zero_threshold_returns_all_analyzed_resolutions(void** state) {
-	float* image = *state;
-	RDResolution* resw,* resh;
-	size_t countw, counth;
-
-	RDParameters* params = resdet_alloc_default_parameters();
-
-	assert_non_null(params);
+	struct image_ctx* ctx = *state;
+	resdet_parameters_set_threshold(ctx->params,0);
 
-	resdet_parameters_set_threshold(params,0);
-	RDError err = resdetect(image,1,768,768,&resw,&countw,&resh,&counth,NULL,params);
-	free(params);
+	RDError err = resdetect(ctx->image,1,768,768,&ctx->resw,&ctx->countw,&ctx->resh,&ctx->counth,NULL,ctx->params);
 
 	assert_false(err);
 
-	assert_uint_equal(countw,745);
-	assert_uint_equal(counth,745);
+	assert_uint_equal(ctx->countw,745);
+	assert_uint_equal(ctx->counth,745);
 }
 
+// setup: setup_resdetect_parameters_tests
+// teardown: teardown_resdetect_parameters_tests
 void test_lower_range_gives_more_results(void** state) {
-	float* image = *state;
-	RDResolution* resw,* resh;
-	size_t countw, counth;
-
-	RDParameters* params = resdet_alloc_default_parameters();
-
-	assert_non_null(params);
+	struct image_ctx* ctx = *state;
+	resdet_parameters_set_range(ctx->params,8);
 
-	resdet_parameters_set_range(params,8);
-	RDError err = resdetect(image,1,768,768,&resw,&countw,&resh,&counth,NULL,params);
-	free(params);
+	RDError err = resdetect(ctx->image,1,768,768,&ctx->resw,&ctx->countw,&ctx->resh,&ctx->counth,NULL,ctx->params);
 
 	assert_false(err);
 
-	assert_uint_equal(countw,3);
-	assert_uint_equal(counth,5);
+	assert_uint_equal(ctx->countw,3);
+	assert_uint_equal(ctx->counth,5);
 }
\ No newline at end of file
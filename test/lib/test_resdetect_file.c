@@ -46,3 +46,82 @@ void test_resdetect_file_nullifies_outputs_on_error(void** state) {
 	assert_uint_equal(countw,0);
 	assert_uint_equal(counth,0);
 }
+
+int setup_resdetect_file_parameters_tests(void** state) {
+	if(!(*state = resdet_alloc_default_parameters()))
+		return 1;
+	return 0;
+}
+
+int teardown_resdetect_file_parameters_tests(void** state) {
+	free(*state);
+	return 0;
+}
+
+struct file_results {
+	size_t count;
+	RDError errors[4];
+	size_t best_widths[4];
+	uint64_t nframes[4];
+	uint64_t decoded[4];
+};
+
+static void collect_file_result(void* ctx, const RDFileResult* result) {
+	struct file_results* results = ctx;
+	results->count++;
+	results->errors[result->index] = result->error;
+	if(!result->error) {
+		results->best_widths[result->index] = result->rw[0].index;
+		results->nframes[result->index] = result->nframes;
+		results->decoded[result->index] = result->stats.stages[RDSTAGE_DECODE].count;
+	}
+}
+
+void test_resdetect_files_reports_every_file(void** state) {
+	const char* files[] = {
+		"test/files/blue_marble_2012_resized.pfm",
+		"test/files/checkerboard.pfm",
+		"test/files/doesntexist.pfm",
+		"test/files/blue_marble_2012_resized.pfm"
+	};
+	struct file_results results = {0};
+
+	RDError err = resdetect_files(files,4,NULL,NULL,NULL,2,collect_file_result,&results);
+
+	assert_false(err);
+	assert_uint_equal(results.count,4);
+	assert_false(results.errors[0]);
+	assert_false(results.errors[1]);
+	assert_true(results.errors[2] < 0);
+	assert_false(results.errors[3]);
+	assert_uint_equal(results.best_widths[0],512);
+	assert_uint_equal(results.best_widths[1],2);
+	assert_uint_equal(results.best_widths[3],512);
+	assert_uint_equal(results.nframes[1],2);
+}
+
+void test_resdetect_files_without_callback_returns_error(void** state) {
+	const char* files[] = { "test/files/checkerboard.pfm" };
+
+	RDError err = resdetect_files(files,1,NULL,NULL,NULL,0,NULL,NULL);
+
+	assert_int_equal(err,RDEPARAM);
+}
+
+// setup: setup_resdetect_file_parameters_tests
+// teardown: teardown_resdetect_file_parameters_tests
+void test_resdetect_files_reports_stats_per_file(void** state) {
+	RDParameters* params = *state;
+	const char* files[] = {
+		"test/files/checkerboard.pfm",
+		"test/files/checkerboard.pfm"
+	};
+	struct file_results results = {0};
+	resdet_parameters_set_stats(params,true);
+
+	RDError err = resdetect_files(files,2,NULL,NULL,params,1,collect_file_result,&results);
+
+	assert_false(err);
+	assert_uint_equal(results.decoded[0],2);
+	assert_uint_equal(results.decoded[1],2);
+}
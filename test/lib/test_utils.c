@@ -93,6 +93,24 @@ void test_negative_threshold_returns_error(void** state) {
 	assert_int_equal(err,RDEPARAM);
 }
 
+// guard: HAVE_MADV_HUGEPAGE
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_sets_huge_pages(void** state) {
+	RDError err = resdet_parameters_set_huge_pages(*state,true);
+
+	assert_false(err);
+}
+
+// guard: !defined(HAVE_MADV_HUGEPAGE)
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_huge_pages_unsupported_returns_error(void** state) {
+	RDError err = resdet_parameters_set_huge_pages(*state,true);
+
+	assert_int_equal(err,RDEPARAM);
+}
+
 void test_setting_threshold_with_no_params_returns_error(void** state) {
 	RDError err = resdet_parameters_set_threshold(NULL,0);
 
@@ -104,3 +122,76 @@ void test_setting_range_with_no_params_returns_error(void** state) {
 
 	assert_int_equal(err,RDEPARAM);
 }
+
+void test_setting_allocator_without_functions_returns_error(void** state) {
+	RDError err = resdet_set_allocator(&(RDAllocator){0});
+
+	assert_int_equal(err,RDEPARAM);
+}
+
+void test_setting_null_allocator_restores_default(void** state) {
+	RDError err = resdet_set_allocator(NULL);
+
+	assert_false(err);
+}
+
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_sets_coarse_fraction(void** state) {
+	RDError err = resdet_parameters_set_coarse_fraction(*state,0.25);
+
+	assert_false(err);
+}
+
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_invalid_coarse_fraction_returns_error(void** state) {
+	assert_int_equal(resdet_parameters_set_coarse_fraction(*state,0),RDEPARAM);
+	assert_int_equal(resdet_parameters_set_coarse_fraction(*state,1.5),RDEPARAM);
+}
+
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_sets_line_sampling(void** state) {
+	RDError err = resdet_parameters_set_line_sampling(*state,8,true);
+
+	assert_false(err);
+}
+
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_zero_line_step_returns_error(void** state) {
+	RDError err = resdet_parameters_set_line_sampling(*state,0,false);
+
+	assert_int_equal(err,RDEPARAM);
+}
+
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_sets_axes(void** state) {
+	RDError err = resdet_parameters_set_axes(*state,false,true);
+
+	assert_false(err);
+}
+
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_no_axes_returns_error(void** state) {
+	RDError err = resdet_parameters_set_axes(*state,false,false);
+
+	assert_int_equal(err,RDEPARAM);
+}
+
+// setup: setup_rdparameter_tests
+// teardown: teardown_rdparameter_tests
+void test_sets_stats(void** state) {
+	RDError err = resdet_parameters_set_stats(*state,true);
+
+	assert_false(err);
+}
+
+void test_all_stages_have_a_name(void** state) {
+	for(enum RDStage stage = 0; stage < RDSTAGE_COUNT; stage++)
+		assert_non_null(resdet_stage_name(stage));
+	assert_null(resdet_stage_name(RDSTAGE_COUNT));
+}